@@ -0,0 +1,243 @@
+/**************************************************************/
+/* Reader for static libraries in the common `ar` format.     */
+/* Handles GNU (SysV) and BSD style long member names.        */
+/**************************************************************/
+
+#pragma once
+
+#include "elf.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define AR_MAGIC     "!<arch>\n"
+#define AR_MAGIC_LEN 8
+
+struct ArMemberHeader
+{
+	char ar_name[16];
+	char ar_date[12];
+	char ar_uid[6];
+	char ar_gid[6];
+	char ar_mode[8];
+	char ar_size[10];
+	char ar_fmag[2];
+};
+
+class Archive
+{
+public:
+	enum Error
+	{
+		ERR_NONE = 0,
+		ERR_FILE_NOT_OPEN,
+		ERR_FILE_READ,
+		ERR_INVALID_HEADER
+	};
+
+	// Members point into the archive's data, which stays mapped for as long as
+	// the Archive does.
+	struct Member
+	{
+		std::string name;
+		char *data;
+		size_t size;
+	};
+
+	std::vector<Member> members;
+
+	Archive(const char *filename)
+	{
+		m_error = ERR_NONE;
+		m_file = nullptr;
+		m_size = 0;
+		m_mapping = nullptr;
+
+		loadFile(filename);
+
+		if (!m_error)
+			readMembers();
+	}
+
+	~Archive()
+	{
+#ifndef _WIN32
+		if (m_mapping)
+		{
+			munmap(m_mapping, m_size);
+			return;
+		}
+#endif
+		delete[] m_file;
+	}
+
+	static bool isArchive(const char *filename)
+	{
+		char magic[AR_MAGIC_LEN];
+		FILE *file = fopen(filename, "rb");
+
+		if (!file)
+			return false;
+
+		size_t bytesRead = fread(magic, 1, AR_MAGIC_LEN, file);
+		fclose(file);
+
+		return bytesRead == AR_MAGIC_LEN && memcmp(magic, AR_MAGIC, AR_MAGIC_LEN) == 0;
+	}
+
+	inline Error getError() const
+	{
+		return m_error;
+	}
+
+private:
+	Error m_error;
+	char *m_file;
+	size_t m_size;
+	void *m_mapping;
+
+	// Maps the archive copy-on-write, since relocations are applied to members
+	// in place, or reads it where mapping isn't available.
+	void loadFile(const char *filename)
+	{
+		FILE *file = fopen(filename, "rb");
+
+		if (!file)
+		{
+			m_error = ERR_FILE_NOT_OPEN;
+			return;
+		}
+
+		uint64_t size = ElfFile::getSize(file);
+
+		if (size < AR_MAGIC_LEN || size > SIZE_MAX)
+		{
+			m_error = ERR_INVALID_HEADER;
+			fclose(file);
+			return;
+		}
+
+		m_size = (size_t)size;
+
+#ifndef _WIN32
+		void *mapping = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(file), 0);
+
+		if (mapping != MAP_FAILED)
+		{
+			fclose(file);
+
+			m_mapping = mapping;
+			m_file = (char*)mapping;
+			return;
+		}
+#endif
+
+		m_file = new char[m_size];
+
+		size_t bytesRead = fread(m_file, sizeof(char), m_size, file);
+		fclose(file);
+
+		if (bytesRead != m_size)
+			m_error = ERR_FILE_READ;
+	}
+
+	static size_t parseDecimal(const char *field, size_t length)
+	{
+		char buf[17] = { 0 };
+		memcpy(buf, field, length);
+		return (size_t)strtoull(buf, nullptr, 10);
+	}
+
+	void readMembers()
+	{
+		if (memcmp(m_file, AR_MAGIC, AR_MAGIC_LEN) != 0)
+		{
+			m_error = ERR_INVALID_HEADER;
+			return;
+		}
+
+		const char *longNames = nullptr;
+		size_t longNamesSize = 0;
+		size_t offset = AR_MAGIC_LEN;
+
+		while (offset + sizeof(ArMemberHeader) <= m_size)
+		{
+			ArMemberHeader *hdr = (ArMemberHeader*)(m_file + offset);
+
+			if (hdr->ar_fmag[0] != '`' || hdr->ar_fmag[1] != '\n')
+			{
+				m_error = ERR_INVALID_HEADER;
+				return;
+			}
+
+			size_t size = parseDecimal(hdr->ar_size, sizeof(hdr->ar_size));
+			char *data = m_file + offset + sizeof(ArMemberHeader);
+
+			if (size > m_size - (offset + sizeof(ArMemberHeader)))
+			{
+				m_error = ERR_INVALID_HEADER;
+				return;
+			}
+
+			std::string name(hdr->ar_name, sizeof(hdr->ar_name));
+			name.erase(name.find_last_not_of(' ') + 1);
+
+			if (name == "/" || name == "/SYM64/" || name == "__.SYMDEF" || name == "__.SYMDEF SORTED")
+			{
+				// Symbol index
+			}
+			else if (name == "//")
+			{
+				longNames = data;
+				longNamesSize = size;
+			}
+			else
+			{
+				Member member;
+				member.data = data;
+				member.size = size;
+
+				if (name.size() > 1 && name[0] == '/' && longNames)
+				{
+					// GNU long name, an offset into the "//" member
+					size_t start = (size_t)strtoull(name.c_str() + 1, nullptr, 10);
+					size_t end = start;
+
+					while (end < longNamesSize && longNames[end] != '\n')
+						end++;
+
+					if (start > longNamesSize)
+						start = end = longNamesSize;
+
+					member.name.assign(longNames + start, end - start);
+				}
+				else if (name.compare(0, 3, "#1/") == 0)
+				{
+					// BSD long name, stored at the start of the member data
+					size_t length = (size_t)strtoull(name.c_str() + 3, nullptr, 10);
+
+					if (length > size)
+						length = size;
+
+					member.name.assign(data, strnlen(data, length));
+					member.data += length;
+					member.size -= length;
+				}
+				else
+					member.name = name;
+
+				if (!member.name.empty() && member.name.back() == '/')
+					member.name.pop_back();
+
+				members.push_back(member);
+			}
+
+			// Members are aligned to 2 bytes
+			offset += sizeof(ArMemberHeader) + size + (size & 1);
+		}
+	}
+};
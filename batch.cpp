@@ -0,0 +1,244 @@
+#include "batch.h"
+#include "archive.h"
+#include "convert.h"
+#include "output.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+struct BatchInput
+{
+	std::string name;
+
+	// Archive members are read in place from their archive's mapping
+	char *data;
+	size_t size;
+
+	ElfFile *elf;
+	Dwarf *dwarf;
+	std::vector<Cpp::File*> files;
+};
+
+static bool convertInput(BatchInput *input)
+{
+	TraceSpan loadSpan("Load ELF");
+	loadSpan.arg("input", input->name);
+
+	if (input->data)
+		input->elf = new ElfFile(input->data, input->size);
+	else
+		input->elf = new ElfFile(input->name.c_str());
+
+	loadSpan.arg("bytes", input->elf->getFileSize());
+	loadSpan.end();
+
+	ElfFile *elf = input->elf;
+
+	if (elf->getError())
+		return error("Failed to parse " + input->name + " as an ELF file. Error Code: " + std::to_string(elf->getError()));
+
+	Elf32_Shdr *debug = elf->getSectionHeader(".debug");
+
+	if (!debug)
+	{
+		logMessage("Skipping " + input->name + ", it has no DWARFv1 information.");
+		return true;
+	}
+
+	// References between entries in an object file are relocations against .debug
+	if (elf->isRelocatable())
+	{
+		Elf32_Shdr *line = elf->getSectionHeader(".line");
+		int unsupported = 0;
+		int unsupportedLine = 0;
+
+		if (!elf->relocateSection(debug, &unsupported) || (line && !elf->relocateSection(line, &unsupportedLine)))
+			return error("Failed to apply relocations in " + input->name + ".");
+
+		// References that weren't relocated would point at the wrong entries
+		if (unsupported + unsupportedLine > 0)
+			return error("Unsupported relocation types in the debugging information of " + input->name + ". Count: " + std::to_string(unsupported + unsupportedLine));
+	}
+
+	input->dwarf = new Dwarf(elf, usedAttributes, getCompileUnitFilter());
+
+	if (input->dwarf->getError())
+		return error("Failed to parse DWARF data in " + input->name + ". Error Code: " + std::to_string(input->dwarf->getError()));
+
+	bool success = processDwarf(input->dwarf);
+
+	input->files = takeConvertedFiles();
+	applySymbolTable(input->files, SymbolTable(elf), !elf->isRelocatable());
+	input->dwarf->freeEntries();
+
+	if (!success)
+		return error("Failed to process DWARF data in " + input->name + ".");
+
+	logMessage("Converted " + input->name + ".");
+
+	return true;
+}
+
+// Renders a type the way it's written out, to tell apart types that only share a generated name
+static std::string toSourceString(Cpp::UserType *ut)
+{
+	if (ut->type == Cpp::UserType::ARRAY || ut->type == Cpp::UserType::FUNCTION)
+		return ut->toDeclarationString();
+
+	return ut->toDefinitionString(false);
+}
+
+static inline const std::string& getFunctionKey(const Cpp::Function &fun)
+{
+	return fun.mangledName.empty() ? fun.name : fun.mangledName;
+}
+
+// Adds what from has and into doesn't to into, for compile units that appear
+// in more than one input. Types, variables and functions are matched by name.
+// Duplicates are dropped but not freed, since what's kept may still refer to them.
+static void mergeFile(Cpp::File *into, Cpp::File *from)
+{
+	std::unordered_map<std::string, Cpp::UserType*> types;
+	std::unordered_set<std::string> variables;
+	std::unordered_set<std::string> functions;
+
+	for (Cpp::UserType *ut : into->userTypes)
+		types.emplace(ut->name, ut);
+
+	for (Cpp::Variable &var : into->variables)
+		variables.insert(var.name);
+
+	for (Cpp::Function &fun : into->functions)
+		functions.insert(getFunctionKey(fun));
+
+	for (Cpp::UserType *ut : from->userTypes)
+	{
+		auto it = types.find(ut->name);
+
+		if (it != types.end())
+		{
+			// Generated names are only unique within an input, so those types
+			// must also look the same
+			if (!ut->anonymous || toSourceString(ut) == toSourceString(it->second))
+				continue;
+
+			std::string base = ut->name;
+
+			for (int i = 1; types.count(ut->name); i++)
+				ut->name = base + "_" + std::to_string(i);
+		}
+
+		ut->index = into->userTypes.size();
+		into->userTypes.push_back(ut);
+		types.emplace(ut->name, ut);
+	}
+
+	for (Cpp::Variable &var : from->variables)
+	{
+		if (variables.insert(var.name).second)
+			into->variables.push_back(var);
+	}
+
+	for (Cpp::Function &fun : from->functions)
+	{
+		if (functions.insert(getFunctionKey(fun)).second)
+			into->functions.push_back(fun);
+	}
+
+	delete from;
+}
+
+int runBatch(std::vector<char*> &inputNames, const char *outDirectory, int jobs, const OutputOptions &options)
+{
+	std::vector<std::unique_ptr<Archive>> archives;
+	std::vector<BatchInput> inputs;
+
+	for (char *name : inputNames)
+	{
+		if (!Archive::isArchive(name))
+		{
+			inputs.push_back({ name, nullptr, 0, nullptr, nullptr, {} });
+			continue;
+		}
+
+		Archive *archive = new Archive(name);
+		archives.emplace_back(archive);
+
+		if (archive->getError())
+		{
+			error(std::string("Failed to read archive ").append(name).append(". Error Code: ").append(std::to_string(archive->getError())));
+			return 1;
+		}
+
+		for (Archive::Member &member : archive->members)
+			inputs.push_back({ std::string(name) + "(" + member.name + ")", member.data, member.size, nullptr, nullptr, {} });
+	}
+
+	std::cout << "Converting " << inputs.size() << " inputs using " << jobs << " threads..." << std::endl;
+
+	std::atomic<size_t> next(0);
+	std::atomic<bool> failed(false);
+
+	auto worker = [&]()
+	{
+		size_t i;
+
+		while ((i = next++) < inputs.size())
+		{
+			if (!convertInput(&inputs[i]))
+				failed = true;
+		}
+	};
+
+	std::vector<std::thread> threads;
+
+	for (int i = 1; i < jobs; i++)
+		threads.emplace_back(worker);
+
+	worker();
+
+	for (std::thread &thread : threads)
+		thread.join();
+
+	if (failed)
+	{
+		std::cout << "Failed to convert some inputs." << std::endl;
+		return 1;
+	}
+
+	// Merge in input order, so the output doesn't depend on thread scheduling
+	std::vector<Cpp::File*> files;
+	std::unordered_map<std::string, Cpp::File*> filesByName;
+
+	for (BatchInput &input : inputs)
+	{
+		for (Cpp::File *cpp : input.files)
+		{
+			auto it = filesByName.find(cpp->filename);
+
+			if (it != filesByName.end())
+				mergeFile(it->second, cpp);
+			else
+			{
+				filesByName[cpp->filename] = cpp;
+				files.push_back(cpp);
+			}
+		}
+	}
+
+	std::cout << "Done converting DWARFv1 data!" << std::endl;
+	std::cout << "\tNumber of C++ files: " << files.size() << std::endl << std::endl;
+
+	MemStats::report(std::cout, "after conversion");
+
+	writeCppFiles(files, outDirectory, jobs, options);
+
+	MemStats::report(std::cout, "at the end of the run");
+
+	std::cout << "Done." << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "output.h"
+
+#include <vector>
+
+// Converts any number of ELF files, relocatable objects and static libraries
+// in parallel, and writes the merged result below outDirectory.
+int runBatch(std::vector<char*> &inputs, const char *outDirectory, int jobs, const OutputOptions &options = OutputOptions());
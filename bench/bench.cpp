@@ -0,0 +1,521 @@
+/**************************************************************/
+/* Microbenchmarks for the DWARF reader and C++ renderer hot  */
+/* paths, run on DWARF data generated in memory.              */
+/**************************************************************/
+
+// Every benchmark is timed over several samples, and each sample repeats its
+// operations until it has run for at least the minimum sample time. Results
+// are printed to stdout as one JSON object per line:
+//
+//   {"name":"Dwarf::readEntry","ops":3442,"ns_per_op":41.2,"min_ns_per_op":40.8,"samples":5}
+//
+// ns_per_op is the median of the samples. Progress goes to stderr.
+
+#include "fixture.h"
+#include "../cpp.h"
+#include "../convert.h"
+#include "../json.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// One compile unit in the shape of typical game code: small structs, an enum,
+// a larger class using them through values, pointers, arrays and bitfields,
+// and member functions with parameters, locals and line numbers.
+static void addCompileUnit(FixtureBuilder &b, int index)
+{
+	std::string suffix = std::to_string(index);
+	Elf32_Addr base = 0x80004000 + index * 0x1000;
+
+	b.begin(DW_TAG_compile_unit);
+	b.string(DW_AT_name, "C:\\bench\\src\\unit" + suffix + ".cpp");
+	b.data4(DW_AT_low_pc, base);
+	b.data4(DW_AT_high_pc, base + 0x1000);
+	b.children();
+
+	Elf32_Off vec = b.begin(DW_TAG_structure_type);
+	b.string(DW_AT_name, "Vec3_" + suffix);
+	b.data4(DW_AT_byte_size, 12);
+	b.children();
+
+	for (int i = 0; i < 3; i++)
+	{
+		b.begin(DW_TAG_member);
+		b.string(DW_AT_name, std::string(1, 'x' + i));
+		b.data2(DW_AT_fund_type, DW_FT_float);
+		b.block2(DW_AT_location, location(i * 4));
+		b.leaf();
+	}
+
+	b.close();
+
+	std::vector<char> elements;
+
+	for (int i = 0; i < 24; i++)
+	{
+		FixtureBuilder::put<Elf32_Word>(23 - i, elements);
+		std::string name = "KIND_" + suffix + "_" + std::to_string(23 - i);
+		elements.insert(elements.end(), name.c_str(), name.c_str() + name.size() + 1);
+	}
+
+	Elf32_Off kind = b.begin(DW_TAG_enumeration_type);
+	b.string(DW_AT_name, "Kind_" + suffix);
+	b.data4(DW_AT_byte_size, 4);
+	b.block4(DW_AT_element_list, elements);
+	b.leaf();
+
+	std::vector<char> subscripts(1, DW_FMT_FT_C_C);
+	FixtureBuilder::put<Elf32_Half>(DW_FT_long, subscripts);
+	FixtureBuilder::put<Elf32_Word>(0, subscripts);
+	FixtureBuilder::put<Elf32_Word>(3, subscripts);
+	subscripts.push_back(DW_FMT_ET);
+	FixtureBuilder::put<Elf32_Half>(DW_AT_user_def_type, subscripts);
+	FixtureBuilder::put<Elf32_Off>(vec, subscripts);
+
+	Elf32_Off array = b.begin(DW_TAG_array_type);
+	b.data2(DW_AT_ordering, DW_ORD_row_major);
+	b.block2(DW_AT_subscr_data, subscripts);
+	b.leaf();
+
+	Elf32_Off callback = b.begin(DW_TAG_subroutine_type);
+	b.data2(DW_AT_fund_type, DW_FT_integer);
+	b.children();
+	b.begin(DW_TAG_formal_parameter);
+	b.data2(DW_AT_fund_type, DW_FT_float);
+	b.leaf();
+	b.begin(DW_TAG_formal_parameter);
+	b.block2(DW_AT_mod_u_d_type, modifiedType({ DW_MOD_pointer_to }, vec));
+	b.leaf();
+	b.close();
+
+	Elf32_Off entity = b.begin(DW_TAG_class_type);
+	b.string(DW_AT_name, "Entity_" + suffix);
+	b.data4(DW_AT_byte_size, 0x80);
+	b.children();
+
+	b.begin(DW_TAG_inheritance);
+	b.data4(DW_AT_user_def_type, vec);
+	b.block2(DW_AT_location, location(0));
+	b.leaf();
+
+	auto member = [&](const std::string &name, int offset)
+	{
+		b.begin(DW_TAG_member);
+		b.string(DW_AT_name, name);
+		b.block2(DW_AT_location, location(offset));
+	};
+
+	member("kind", 0xc);
+	b.data4(DW_AT_user_def_type, kind);
+	b.leaf();
+
+	member("pos", 0x10);
+	b.data4(DW_AT_user_def_type, array);
+	b.leaf();
+
+	member("callback", 0x40);
+	b.data4(DW_AT_user_def_type, callback);
+	b.leaf();
+
+	for (int i = 0; i < 2; i++)
+	{
+		member(i ? "flagsB" : "flagsA", 0x44);
+		b.data2(DW_AT_fund_type, DW_FT_unsigned_integer);
+		b.data4(DW_AT_byte_size, 4);
+		b.data2(DW_AT_bit_offset, 28 - i * 4);
+		b.data4(DW_AT_bit_size, 4);
+		b.leaf();
+	}
+
+	member("name", 0x48);
+	b.block2(DW_AT_mod_fund_type, modifiedFundamental({ DW_MOD_pointer_to, DW_MOD_const }, DW_FT_char));
+	b.leaf();
+
+	member("next", 0x4c);
+	b.block2(DW_AT_mod_u_d_type, modifiedType({ DW_MOD_pointer_to }, entity));
+	b.leaf();
+
+	for (int i = 0; i < 12; i++)
+	{
+		member("field" + std::to_string(i), 0x50 + i * 4);
+		b.data2(DW_AT_fund_type, (i % 3) ? DW_FT_float : DW_FT_signed_integer);
+		b.leaf();
+	}
+
+	b.close();
+
+	std::vector<char> address(1, DW_OP_ADDR);
+	FixtureBuilder::put<Elf32_Addr>(0x80400000 + index * 0x80, address);
+
+	b.begin(DW_TAG_global_variable);
+	b.string(DW_AT_name, "gEntity" + suffix);
+	b.data4(DW_AT_user_def_type, entity);
+	b.block2(DW_AT_location, address);
+	b.leaf();
+
+	for (int f = 0; f < 4; f++)
+	{
+		Elf32_Addr address = base + 0x100 * (f + 1);
+		std::string name = "Update" + std::to_string(f);
+
+		b.begin(DW_TAG_global_subroutine);
+		b.string(DW_AT_name, name);
+		b.string(DW_AT_mangled_name, name + "__8Entity_" + suffix + "Ff");
+		b.data2(DW_AT_fund_type, DW_FT_void);
+		b.data4(DW_AT_low_pc, address);
+		b.data4(DW_AT_high_pc, address + 0xc0);
+		b.children();
+
+		b.begin(DW_TAG_formal_parameter);
+		b.string(DW_AT_name, "this");
+		b.block2(DW_AT_mod_u_d_type, modifiedType({ DW_MOD_pointer_to }, entity));
+		b.leaf();
+
+		b.begin(DW_TAG_formal_parameter);
+		b.string(DW_AT_name, "dt");
+		b.data2(DW_AT_fund_type, DW_FT_float);
+		b.leaf();
+
+		b.begin(DW_TAG_formal_parameter);
+		b.string(DW_AT_name, "target");
+		b.block2(DW_AT_mod_u_d_type, modifiedType({ DW_MOD_const, DW_MOD_reference_to }, vec));
+		b.leaf();
+
+		b.begin(DW_TAG_lexical_block);
+		b.data4(DW_AT_low_pc, address + 0x10);
+		b.data4(DW_AT_high_pc, address + 0xb0);
+		b.children();
+
+		b.begin(DW_TAG_local_variable);
+		b.string(DW_AT_name, "delta");
+		b.data4(DW_AT_user_def_type, vec);
+		b.leaf();
+
+		b.begin(DW_TAG_local_variable);
+		b.string(DW_AT_name, "i");
+		b.data2(DW_AT_fund_type, DW_FT_signed_integer);
+		b.leaf();
+
+		b.close();
+		b.close();
+
+		b.lines(address, 16);
+	}
+
+	b.close();
+}
+
+struct Options
+{
+	int compileUnits = 200;
+	int samples = 5;
+	double minSampleMs = 50;
+	const char *filter = nullptr;
+};
+
+static Options options;
+
+static volatile size_t sink;
+
+// Times body, which does ops operations per call, and prints the result
+template<typename F>
+static void run(const char *name, size_t ops, F body)
+{
+	if (options.filter && !strstr(name, options.filter))
+		return;
+
+	std::cerr << "Running " << name << "..." << std::endl;
+
+	typedef std::chrono::steady_clock Clock;
+	std::vector<double> samples;
+
+	// Warm up, and find how many calls fill a sample
+	size_t calls = 1;
+
+	while (true)
+	{
+		auto start = Clock::now();
+
+		for (size_t i = 0; i < calls; i++)
+			sink = sink + body();
+
+		double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		if (ms >= options.minSampleMs)
+			break;
+
+		calls *= (ms > 0) ? std::max<size_t>(2, (size_t)(options.minSampleMs / ms) + 1) : 10;
+	}
+
+	for (int s = 0; s < options.samples; s++)
+	{
+		auto start = Clock::now();
+
+		for (size_t i = 0; i < calls; i++)
+			sink = sink + body();
+
+		double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+		samples.push_back(ns / ((double)calls * ops));
+	}
+
+	std::sort(samples.begin(), samples.end());
+
+	std::cout << "{\"name\":" << Json::escape(name) << ",\"ops\":" << ops <<
+		",\"ns_per_op\":" << samples[samples.size() / 2] <<
+		",\"min_ns_per_op\":" << samples[0] <<
+		",\"samples\":" << samples.size() << "}" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+			options.filter = argv[++i];
+		else if (strcmp(argv[i], "--cus") == 0 && i + 1 < argc)
+			options.compileUnits = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+			options.samples = std::max(1, atoi(argv[++i]));
+		else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+			options.minSampleMs = std::max(1.0, atof(argv[++i]));
+		else
+		{
+			std::cerr << "Usage: bench [--filter <name part>] [--cus <count>] [--samples <count>] [--min-time <ms per sample>]" << std::endl;
+			return 1;
+		}
+	}
+
+	FixtureBuilder builder;
+
+	for (int i = 0; i < options.compileUnits; i++)
+		addCompileUnit(builder, i);
+
+	std::vector<char> image = builder.build();
+	ElfFile elf(image.data(), image.size());
+	Dwarf *dwarf = new Dwarf(&elf, usedAttributes);
+
+	if (elf.getError() || dwarf->getError())
+	{
+		std::cerr << "Failed to parse the generated DWARF data." << std::endl;
+		return 1;
+	}
+
+	// Reading
+
+	size_t attributeCount = 0;
+	std::vector<Elf32_Off> references;
+
+	for (int i = 0; i < dwarf->numEntries; i++)
+	{
+		Dwarf::Entry *entry = &dwarf->entries[i];
+		attributeCount += entry->numAttributes;
+
+		for (int a = 0; a < entry->numAttributes; a++)
+		{
+			if (entry->attributes[a].getForm() == DW_FORM_REF)
+				references.push_back(entry->attributes[a].getReference());
+		}
+	}
+
+	Dwarf::Entry scratch;
+
+	run("Dwarf::readEntry", dwarf->numEntries, [&]()
+	{
+		size_t found = 0;
+
+		for (int i = 0; i < dwarf->numEntries; i++)
+		{
+			scratch.clearAttributes();
+			dwarf->readEntry(dwarf->entries[i].offset, &scratch, i);
+			found += scratch.numAttributes;
+		}
+
+		return found;
+	});
+
+	run("Dwarf::readAttribute", attributeCount, [&]()
+	{
+		size_t total = 0;
+
+		for (int i = 0; i < dwarf->numEntries; i++)
+		{
+			Dwarf::Entry *entry = &dwarf->entries[i];
+			scratch.offset = entry->offset;
+			scratch.length = entry->length;
+
+			for (int a = 0; a < entry->numAttributes; a++)
+			{
+				scratch.clearAttributes();
+				total += dwarf->readAttribute(entry->attributes[a].offset, &scratch);
+			}
+		}
+
+		return total;
+	});
+
+	run("Entry::getSibling", dwarf->numEntries, [&]()
+	{
+		size_t total = 0;
+
+		for (int i = 0; i < dwarf->numEntries; i++)
+			total += (size_t)dwarf->entries[i].getSibling();
+
+		return total;
+	});
+
+	run("Dwarf::getEntryFromReference", references.size(), [&]()
+	{
+		size_t total = 0;
+
+		for (Elf32_Off ref : references)
+			total += (size_t)dwarf->getEntryFromReference(ref);
+
+		return total;
+	});
+
+	run("Dwarf::findTag", dwarf->numEntries, [&]()
+	{
+		size_t found = 0;
+
+		for (int i = dwarf->findTag(DW_TAG_structure_type, 0); i < dwarf->numEntries; i = dwarf->findTag(DW_TAG_structure_type, i + 1))
+			found++;
+
+		return found;
+	});
+
+	// Converting
+
+	if (!processDwarf(dwarf))
+	{
+		std::cerr << "Failed to convert the generated DWARF data." << std::endl;
+		return 1;
+	}
+
+	std::vector<Dwarf::Attribute*> typeAttributes;
+
+	for (int i = 0; i < dwarf->numEntries; i++)
+	{
+		Dwarf::Entry *entry = &dwarf->entries[i];
+
+		if (entry->tag != DW_TAG_member && entry->tag != DW_TAG_formal_parameter &&
+			entry->tag != DW_TAG_local_variable && entry->tag != DW_TAG_global_variable)
+			continue;
+
+		for (int a = 0; a < entry->numAttributes; a++)
+		{
+			Elf32_Half name = entry->attributes[a].name;
+
+			if (name == DW_AT_fund_type || name == DW_AT_mod_fund_type ||
+				name == DW_AT_user_def_type || name == DW_AT_mod_u_d_type)
+				typeAttributes.push_back(&entry->attributes[a]);
+		}
+	}
+
+	// Converted types are looked up in the state processDwarf left behind
+	run("processTypeAttr", typeAttributes.size(), [&]()
+	{
+		size_t total = 0;
+
+		for (Dwarf::Attribute *attr : typeAttributes)
+		{
+			Cpp::Type type;
+			total += processTypeAttr(attr, &type);
+		}
+
+		return total;
+	});
+
+	std::vector<Cpp::File*> files = takeConvertedFiles();
+
+	// Rendering
+
+	std::vector<Cpp::Type*> types;
+	std::vector<Cpp::ClassType*> classes;
+	std::vector<Cpp::EnumType*> enums;
+	std::vector<Cpp::Function*> functions;
+
+	for (Cpp::File *file : files)
+	{
+		for (Cpp::UserType *ut : file->userTypes)
+		{
+			if (ut->type == Cpp::UserType::ENUM)
+				enums.push_back(ut->enumData);
+			else if (ut->type == Cpp::UserType::CLASS || ut->type == Cpp::UserType::STRUCT || ut->type == Cpp::UserType::UNION)
+			{
+				classes.push_back(ut->classData);
+
+				for (Cpp::ClassType::Member &m : ut->classData->members)
+					types.push_back(&m.type);
+			}
+		}
+
+		for (Cpp::Function &f : file->functions)
+		{
+			functions.push_back(&f);
+
+			for (Cpp::FunctionType::Parameter &p : f.parameters)
+				types.push_back(&p.type);
+		}
+	}
+
+	run("Type::toString", types.size(), [&]()
+	{
+		size_t total = 0;
+
+		for (Cpp::Type *type : types)
+			total += type->toString("value").size();
+
+		return total;
+	});
+
+	run("ClassType::toBodyString", classes.size(), [&]()
+	{
+		size_t total = 0;
+
+		for (Cpp::ClassType *c : classes)
+			total += c->toBodyString(true).size();
+
+		return total;
+	});
+
+	run("EnumType::toBodyString", enums.size(), [&]()
+	{
+		size_t total = 0;
+
+		for (Cpp::EnumType *e : enums)
+			total += e->toBodyString().size();
+
+		return total;
+	});
+
+	run("Function::toDefinitionString", functions.size(), [&]()
+	{
+		size_t total = 0;
+
+		for (Cpp::Function *f : functions)
+			total += f->toDefinitionString().size();
+
+		return total;
+	});
+
+	std::vector<int> values;
+
+	for (int i = 0; i < 1024; i++)
+		values.push_back((int)(i * 2654435761u) >> (i % 24));
+
+	run("toHexString", values.size(), [&]()
+	{
+		size_t total = 0;
+
+		for (int value : values)
+			total += Cpp::toHexString(value).size();
+
+		return total;
+	});
+
+	return 0;
+}
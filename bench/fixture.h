@@ -0,0 +1,213 @@
+/**************************************************************/
+/* Builds ELF images with DWARF 1 data in memory, for the     */
+/* microbenchmarks and the regression tests.                  */
+/**************************************************************/
+
+#pragma once
+
+#include "../elf.h"
+#include "../dwarf.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Writes DWARF 1 entries, building each entry's sibling reference as its
+// subtree is closed
+class FixtureBuilder
+{
+public:
+	// Starts an entry. Attributes follow, then leaf(), or children() and
+	// later close() for an entry with children.
+	Elf32_Off begin(Elf32_Half tag)
+	{
+		Elf32_Off start = (Elf32_Off)m_debug.size();
+
+		put<Elf32_Word>(0);
+		put<Elf32_Half>(tag);
+		put<Elf32_Half>(DW_AT_sibling);
+
+		m_open.push_back({ start, (Elf32_Off)m_debug.size() });
+		put<Elf32_Off>(0);
+
+		return start;
+	}
+
+	void leaf()
+	{
+		patchLength();
+		patchSibling();
+	}
+
+	void children()
+	{
+		patchLength();
+	}
+
+	void close()
+	{
+		put<Elf32_Word>(4); // Null entry
+		patchSibling();
+	}
+
+	void string(Elf32_Half name, const std::string &value)
+	{
+		put<Elf32_Half>(name);
+		m_debug.insert(m_debug.end(), value.c_str(), value.c_str() + value.size() + 1);
+	}
+
+	void data2(Elf32_Half name, Elf32_Half value)
+	{
+		put<Elf32_Half>(name);
+		put<Elf32_Half>(value);
+	}
+
+	void data4(Elf32_Half name, Elf32_Word value)
+	{
+		put<Elf32_Half>(name);
+		put<Elf32_Word>(value);
+	}
+
+	void block2(Elf32_Half name, const std::vector<char> &block)
+	{
+		put<Elf32_Half>(name);
+		put<Elf32_Half>((Elf32_Half)block.size());
+		m_debug.insert(m_debug.end(), block.begin(), block.end());
+	}
+
+	void block4(Elf32_Half name, const std::vector<char> &block)
+	{
+		put<Elf32_Half>(name);
+		put<Elf32_Word>((Elf32_Word)block.size());
+		m_debug.insert(m_debug.end(), block.begin(), block.end());
+	}
+
+	// Line numbers of the function at address
+	void lines(Elf32_Addr address, int count)
+	{
+		put<Elf32_Word>((Elf32_Word)(2 * sizeof(Elf32_Word) + count * (2 * sizeof(int) + sizeof(short))), m_line);
+		put<Elf32_Addr>(address, m_line);
+
+		for (int i = 0; i < count; i++)
+		{
+			put<int>((i == count - 1) ? 0 : 10 + i * 2, m_line);
+			put<short>(-1, m_line);
+			put<int>(i * 8, m_line);
+		}
+	}
+
+	// Wraps the data in an ELF image with .debug and .line sections, in the
+	// host's byte order
+	std::vector<char> build()
+	{
+		static const char names[] = "\0.debug\0.line\0.shstrtab";
+
+		// Compilers end .debug with a null entry, which the last compile unit's sibling points to
+		put<Elf32_Word>(4);
+		Elf32_Half one = 1;
+		bool little = *(char*)&one == 1;
+
+		std::vector<char> image(sizeof(Elf32_Ehdr));
+		std::vector<Elf32_Shdr> sections(4);
+		memset(sections.data(), 0, sections.size() * sizeof(Elf32_Shdr));
+
+		auto addSection = [&](int index, Elf32_Word name, Elf32_Word type, const char *data, size_t size)
+		{
+			while (image.size() % 4)
+				image.push_back(0);
+
+			sections[index].sh_name = name;
+			sections[index].sh_type = type;
+			sections[index].sh_offset = (Elf32_Off)image.size();
+			sections[index].sh_size = (Elf32_Word)size;
+			sections[index].sh_addralign = 1;
+			image.insert(image.end(), data, data + size);
+		};
+
+		addSection(1, 1, 0x70000005, m_debug.data(), m_debug.size());
+		addSection(2, 8, SHT_PROGBITS, m_line.data(), m_line.size());
+		addSection(3, 14, SHT_STRTAB, names, sizeof(names));
+
+		while (image.size() % 4)
+			image.push_back(0);
+
+		Elf32_Ehdr header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.e_ident, "\x7f" "ELF", 4);
+		header.e_ident[EI_CLASS] = ELFCLASS32;
+		header.e_ident[EI_DATA] = little ? ELFDATA2LSB : ELFDATA2MSB;
+		header.e_ident[EI_VERSION] = EV_CURRENT;
+		header.e_type = ET_EXEC;
+		header.e_version = EV_CURRENT;
+		header.e_shoff = (Elf32_Off)image.size();
+		header.e_ehsize = sizeof(Elf32_Ehdr);
+		header.e_shentsize = sizeof(Elf32_Shdr);
+		header.e_shnum = (Elf32_Half)sections.size();
+		header.e_shstrndx = 3;
+
+		memcpy(image.data(), &header, sizeof(header));
+		image.insert(image.end(), (char*)sections.data(), (char*)(sections.data() + sections.size()));
+
+		return image;
+	}
+
+	template<typename T>
+	static void put(T value, std::vector<char> &out)
+	{
+		out.insert(out.end(), (char*)&value, (char*)&value + sizeof(T));
+	}
+
+private:
+	struct Open
+	{
+		Elf32_Off start;
+		Elf32_Off siblingPos; // Where the sibling reference goes
+	};
+
+	std::vector<char> m_debug;
+	std::vector<char> m_line;
+	std::vector<Open> m_open;
+
+	template<typename T>
+	void put(T value)
+	{
+		put(value, m_debug);
+	}
+
+	template<typename T>
+	void patch(Elf32_Off pos, T value)
+	{
+		memcpy(&m_debug[pos], &value, sizeof(T));
+	}
+
+	void patchLength()
+	{
+		patch<Elf32_Word>(m_open.back().start, (Elf32_Word)(m_debug.size() - m_open.back().start));
+	}
+
+	void patchSibling()
+	{
+		patch<Elf32_Off>(m_open.back().siblingPos, (Elf32_Off)m_debug.size());
+		m_open.pop_back();
+	}
+};
+
+inline std::vector<char> location(int offset)
+{
+	std::vector<char> block(1, DW_OP_CONST);
+	FixtureBuilder::put<Elf32_Word>(offset, block);
+	block.push_back(DW_OP_ADD);
+	return block;
+}
+
+inline std::vector<char> modifiedType(std::vector<char> modifiers, Elf32_Off ref)
+{
+	FixtureBuilder::put<Elf32_Off>(ref, modifiers);
+	return modifiers;
+}
+
+inline std::vector<char> modifiedFundamental(std::vector<char> modifiers, Elf32_Half type)
+{
+	FixtureBuilder::put<Elf32_Half>(type, modifiers);
+	return modifiers;
+}
@@ -0,0 +1,1140 @@
+#include "convert.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+thread_local std::vector<Cpp::File*> cppFiles;
+thread_local std::map<Dwarf::Entry*, Cpp::UserType*> entryUTPairs;
+thread_local std::map<std::string, std::vector<Cpp::UserType*>> nameUTListPairs;
+
+thread_local int currentCompileUnitIndex = 0;
+thread_local Cpp::File *currentCppFile = nullptr;
+thread_local std::function<Cpp::UserType*(Elf32_Off ref)> skippedTypeResolver;
+
+ExtractFilter extractFilter;
+
+const uint64_t usedAttributes =
+	DW_AT_BIT(DW_AT_sibling) | DW_AT_BIT(DW_AT_location) | DW_AT_BIT(DW_AT_name) |
+	DW_AT_BIT(DW_AT_fund_type) | DW_AT_BIT(DW_AT_mod_fund_type) | DW_AT_BIT(DW_AT_user_def_type) |
+	DW_AT_BIT(DW_AT_mod_u_d_type) | DW_AT_BIT(DW_AT_ordering) | DW_AT_BIT(DW_AT_subscr_data) |
+	DW_AT_BIT(DW_AT_byte_size) | DW_AT_BIT(DW_AT_bit_offset) | DW_AT_BIT(DW_AT_bit_size) |
+	DW_AT_BIT(DW_AT_element_list) | DW_AT_BIT(DW_AT_low_pc) | DW_AT_BIT(DW_AT_high_pc) |
+	DW_AT_BIT(DW_AT_mangled_name);
+
+static std::mutex logMutex;
+
+bool error(std::string errorMessage) {
+	std::lock_guard<std::mutex> lock(logMutex);
+
+	std::cout << "ERROR: " << errorMessage << std::endl;
+	return false;
+}
+
+void logMessage(std::string message)
+{
+	std::lock_guard<std::mutex> lock(logMutex);
+
+	std::cout << message << std::endl;
+}
+
+std::vector<Cpp::File*> takeConvertedFiles()
+{
+	std::vector<Cpp::File*> files;
+	files.swap(cppFiles);
+
+	entryUTPairs.clear();
+	nameUTListPairs.clear();
+	currentCompileUnitIndex = 0;
+	currentCppFile = nullptr;
+
+	return files;
+}
+
+Dwarf* convertElfFile(const char *filename, SymbolTable **outSymbols)
+{
+	std::cout << "Loading ELF file " << filename << "..." << std::endl;
+
+	TraceSpan loadSpan("Load ELF");
+	ElfFile *elf = new ElfFile(filename);
+	loadSpan.arg("bytes", elf->getFileSize());
+	loadSpan.end();
+
+	if (elf->getError()) {
+		std::cout << "Failed to parse " << filename << " as an ELF file. Error Code: " << elf->getError() << std::endl;
+		return nullptr;
+	}
+
+	std::cout << "Loading DWARFv1 information..." << std::endl;
+
+	Dwarf *dwarf = new Dwarf(elf, usedAttributes, getCompileUnitFilter());
+
+	if (dwarf->getError()) {
+		std::cout << "Failed to parse DWARF data. Error Code: " << dwarf->getError() << std::endl;
+		return nullptr;
+	}
+
+	MemStats::report(std::cout, "after parsing DWARF data");
+
+	std::cout << "Converting DWARFv1 entries to C++ data..." << std::endl;
+
+	if (!processDwarf(dwarf)) {
+		std::cout << "Failed to process DWARF data." << std::endl;
+		return nullptr;
+	}
+
+	SymbolTable *symbols = new SymbolTable(elf);
+	applySymbolTable(cppFiles, *symbols, !elf->isRelocatable());
+
+	if (outSymbols)
+		*outSymbols = symbols;
+	else
+		delete symbols;
+
+	std::cout << "Done converting DWARFv1 data!" << std::endl;
+	std::cout << "\tNumber of C++ files: " << cppFiles.size() << std::endl << std::endl;
+
+	MemStats::report(std::cout, "after conversion");
+
+	return dwarf;
+}
+
+Dwarf::CompileUnitFilter getCompileUnitFilter()
+{
+	if (!extractFilter.compileUnits.isActive())
+		return nullptr;
+
+	return [](const char *name, size_t length) { return extractFilter.compileUnits.matches(name, length); };
+}
+
+// Whether the function's name or mangled name passes the function filter
+static bool isFunctionSelected(Dwarf::Entry *entry)
+{
+	Dwarf::Attribute *name = entry->get(DW_AT_name);
+	Dwarf::Attribute *mangledName = entry->get(DW_AT_mangled_name);
+
+	if (!name)
+		return mangledName && extractFilter.functions.matches(mangledName->getString(), mangledName->getStringLength());
+
+	return extractFilter.functions.matches(name->getString(), name->getStringLength(),
+		mangledName ? mangledName->getString() : nullptr, mangledName ? mangledName->getStringLength() : 0);
+}
+
+// The attribute giving the type of a variable, member, parameter or function's return value
+static Dwarf::Attribute* getTypeAttribute(Dwarf::Entry *entry)
+{
+	const uint64_t typeAttributes =
+		DW_AT_BIT(DW_AT_fund_type) | DW_AT_BIT(DW_AT_user_def_type) |
+		DW_AT_BIT(DW_AT_mod_fund_type) | DW_AT_BIT(DW_AT_mod_u_d_type);
+
+	if (!(entry->attributeMask & typeAttributes))
+		return nullptr;
+
+	Dwarf::Attribute *attr;
+
+	if ((attr = entry->get(DW_AT_fund_type)) || (attr = entry->get(DW_AT_user_def_type)) ||
+		(attr = entry->get(DW_AT_mod_fund_type)) || (attr = entry->get(DW_AT_mod_u_d_type)))
+		return attr;
+
+	return nullptr;
+}
+
+void applySymbolTable(std::vector<Cpp::File*> &files, const SymbolTable &symbols, bool fillAddresses)
+{
+	for (Cpp::File *cpp : files)
+	{
+		for (Cpp::Function &fun : cpp->functions)
+		{
+			const SymbolTable::Symbol *sym = nullptr;
+
+			if (!fun.mangledName.empty())
+				sym = symbols.findByName(fun.mangledName);
+
+			if (!sym)
+				sym = symbols.findByName(fun.name);
+
+			if (sym && fun.startAddress != 0 && sym->address != fun.startAddress)
+				sym = nullptr;
+
+			if (!sym && fun.startAddress != 0)
+			{
+				sym = symbols.findByAddress(fun.startAddress);
+
+				if (sym && sym->address != fun.startAddress)
+					sym = nullptr;
+			}
+
+			if (!sym || sym->type != STT_FUNC)
+				continue;
+
+			if (fun.startAddress == 0)
+			{
+				if (!fillAddresses)
+					continue;
+
+				fun.startAddress = sym->address;
+			}
+
+			fun.size = sym->size;
+
+			if (fun.endAddress == 0 && sym->size != 0)
+				fun.endAddress = sym->address + sym->size;
+		}
+
+		if (!fillAddresses)
+			continue;
+
+		for (Cpp::Variable &var : cpp->variables)
+		{
+			if (var.address != 0)
+				continue;
+
+			const SymbolTable::Symbol *sym = symbols.findByName(var.name);
+
+			if (sym && sym->type == STT_OBJECT)
+				var.address = sym->address;
+		}
+	}
+}
+
+Cpp::File* findCppFile(Dwarf::Entry *entry, const char **outFilename)
+{
+	*outFilename = nullptr;
+	size_t outLength = 0;
+
+	Dwarf::Attribute *name = entry->get(DW_AT_name);
+
+	if (name)
+	{
+		*outFilename = name->getString();
+		outLength = name->getStringLength();
+	}
+
+	if (*outFilename)
+	{
+		for (Cpp::File *cpp : cppFiles)
+		{
+			if (cpp->filename.size() == outLength &&
+				memcmp(cpp->filename.data(), *outFilename, outLength) == 0)
+				return cpp;
+		}
+	}
+
+	return nullptr;
+}
+
+void fixUserTypeNames()
+{
+	for (auto const &x : nameUTListPairs)
+	{
+		bool noname = x.first.empty();
+		bool duplicate = x.second.size() > 1;
+
+		if (noname || duplicate)
+		{
+			for (size_t i = 0; i < x.second.size(); i++)
+			{
+				Cpp::UserType *ut = x.second[i];
+
+				if (noname)
+				{
+					ut->name = "type";
+					ut->anonymous = true;
+				}
+
+				if (duplicate)
+					ut->name += "_" + std::to_string(i);
+			}
+		}
+	}
+}
+
+bool processDwarf(Dwarf *dwarf)
+{
+	Dwarf::Entry *entry = dwarf->entries.data();
+	Dwarf::Entry *end = entry + dwarf->numEntries;
+
+	while (entry && entry < end)
+	{
+		if (entry->tag == DW_TAG_compile_unit && !convertCompileUnit(entry))
+			return false;
+
+		entry = entry->getSibling();
+	}
+
+	return true;
+}
+
+Cpp::File* convertCompileUnit(Dwarf::Entry *entry)
+{
+	const char *filename;
+	Cpp::File *cpp = findCppFile(entry, &filename);
+
+	bool found = (cpp != nullptr);
+
+	if (!found)
+	{
+		cpp = new Cpp::File;
+		cpp->filename = filename;
+	}
+
+	TraceSpan span("processCompileUnit");
+
+	if (Trace::isEnabled())
+	{
+		Dwarf *dwarf = entry->dwarf;
+		Dwarf::Entry *next = entry->getSibling();
+		span.arg("cu", cpp->filename);
+		span.arg("entries", (next ? next : dwarf->entries.data() + dwarf->numEntries) - entry);
+	}
+
+	if (!processCompileUnit(entry, cpp))
+	{
+		error(std::string("Failed to processCompileUnit for '").append(cpp->filename).append("'"));
+		return nullptr;
+	}
+
+	if (!found)
+		cppFiles.push_back(cpp);
+
+	//std::cout << "Found compile unit " << cpp->filename << std::endl;
+	//std::cout << "\t" << std::to_string(cpp->userTypes.size()) << " user types" << std::endl;
+	//std::cout << "\t" << std::to_string(cpp->variables.size()) << " variables" << std::endl;
+
+	return cpp;
+}
+
+LateMethods findLateMethods(Dwarf *dwarf, const std::vector<int> &units)
+{
+	TraceSpan span("Find late methods");
+
+	LateMethods late;
+	late.lastByTarget.resize(units.size());
+
+	for (size_t i = 0; i < units.size(); i++)
+		late.lastByTarget[i] = i;
+
+	const uint64_t attributes = DW_AT_BIT(DW_AT_name) | DW_AT_BIT(DW_AT_mangled_name) |
+		DW_AT_BIT(DW_AT_user_def_type) | DW_AT_BIT(DW_AT_mod_u_d_type);
+
+	Dwarf::Entry peek;
+	std::string className;
+	size_t unit = 0;
+
+	for (int i = units.empty() ? dwarf->numEntries : units[0]; i < dwarf->numEntries; i++)
+	{
+		while (unit + 1 < units.size() && units[unit + 1] <= i)
+			unit++;
+
+		switch (dwarf->tags[i])
+		{
+		case DW_TAG_global_subroutine:
+		case DW_TAG_subroutine:
+		case DW_TAG_inlined_subroutine:
+		{
+			if (!dwarf->peekEntry(dwarf->entries[i].offset, &peek, attributes))
+				break;
+
+			Dwarf::Attribute *mangledName = peek.get(DW_AT_mangled_name);
+
+			if (mangledName && getMangledClassName(std::string(mangledName->getString(), mangledName->getStringLength()), &className))
+				late.lastByClassName[className] = unit;
+
+			break;
+		}
+		case DW_TAG_formal_parameter:
+		{
+			if (!dwarf->peekEntry(dwarf->entries[i].offset, &peek, attributes))
+				break;
+
+			Dwarf::Attribute *name = peek.get(DW_AT_name);
+			Dwarf::Attribute *type;
+			Elf32_Off ref;
+
+			if (!name || strcmp(name->getString(), "this") != 0)
+				break;
+
+			if ((type = peek.get(DW_AT_user_def_type)))
+				ref = type->getReference();
+			else if ((type = peek.get(DW_AT_mod_u_d_type)) && type->size >= sizeof(Elf32_Off))
+				ref = dwarf->read<Elf32_Off>(type->getBlock() + type->size - sizeof(Elf32_Off));
+			else
+				break;
+
+			// The compile unit the class is in, if it's an earlier one
+			size_t target = std::upper_bound(units.begin(), units.begin() + unit + 1, ref,
+				[&](Elf32_Off offset, int entry) { return offset < dwarf->entries[entry].offset; }) - units.begin();
+
+			if (target > 0 && target - 1 < unit)
+				late.lastByTarget[target - 1] = unit;
+
+			break;
+		}
+		}
+	}
+
+	return late;
+}
+
+bool processCompileUnit(Dwarf::Entry *entry, Cpp::File *cpp)
+{
+	nameUTListPairs.clear();
+	currentCppFile = cpp;
+
+	Dwarf::Entry *next = entry->getSibling();
+	Dwarf::Attribute *name = entry->get(DW_AT_name);
+
+	if (name)
+		cpp->filename.assign(name->getString(), name->getStringLength());
+
+	// Types are created up front so entries can refer to types that come after them
+	static const Dwarf::TagIndex typeIndexes[] = {
+		Dwarf::INDEX_STRUCTURES, Dwarf::INDEX_UNIONS, Dwarf::INDEX_ENUMS,
+		Dwarf::INDEX_ARRAYS, Dwarf::INDEX_SUBROUTINE_TYPES
+	};
+
+	Dwarf *dwarf = entry->dwarf;
+
+	for (Dwarf::TagIndex kind : typeIndexes)
+	{
+		for (int index : dwarf->getIndexed(kind, entry))
+			entryUTPairs[&dwarf->entries[index]] = new Cpp::UserType;
+	}
+
+	entry++;
+
+	while (entry && entry < next)
+	{
+		switch (entry->tag)
+		{
+		case DW_TAG_global_variable:
+		case DW_TAG_local_variable:
+		{
+			Cpp::Variable var;
+
+			if (!processVariable(entry, &var))
+				return error("Failed to processVar.");
+
+			cpp->variables.push_back(var);
+			break;
+		}
+		case DW_TAG_class_type:
+		case DW_TAG_structure_type:
+		case DW_TAG_enumeration_type:
+		case DW_TAG_array_type:
+		case DW_TAG_subroutine_type:
+		case DW_TAG_union_type:
+		{
+			Cpp::UserType *userType = entryUTPairs[entry];
+			processUserType(entry, userType);
+
+			// Filtered out types are still converted, since selected ones can refer to them
+			if (!extractFilter.types.isActive() || extractFilter.types.matches(userType->name))
+			{
+				userType->index = cpp->userTypes.size();
+				cpp->userTypes.push_back(userType);
+			}
+
+			nameUTListPairs[userType->name].push_back(userType);
+			break;
+		}
+		case DW_TAG_global_subroutine:
+		case DW_TAG_subroutine:
+		case DW_TAG_inlined_subroutine:
+		{
+			if (extractFilter.functions.isActive() && !isFunctionSelected(entry))
+				break;
+
+			Cpp::Function f;
+			f.dwarf = entry->dwarf;
+
+			if (!processFunctionType(entry, &f))
+				return error("Failed to processFunctionType.");
+
+			if (!processFunction(entry, &f))
+				return error("Failed to processFunction.");
+
+			cpp->functions.push_back(f);
+		}
+		}
+
+		entry = entry->getSibling();
+	}
+
+	TraceSpan span("fixUserTypeNames");
+	span.arg("names", nameUTListPairs.size());
+
+	fixUserTypeNames();
+	span.end();
+
+	// Layouts are cached on first use without any locking. Computing them all
+	// here, on the converting thread, leaves the types read-only once their
+	// file is handed on to be rendered.
+	for (auto const &x : nameUTListPairs)
+	{
+		for (Cpp::UserType *ut : x.second)
+			ut->getLayout();
+	}
+
+	return true;
+}
+
+bool processVariable(Dwarf::Entry *entry, Cpp::Variable *var)
+{
+	var->isGlobal = (entry->tag == DW_TAG_global_variable);
+	var->address = 0;
+
+	Dwarf::Attribute *attr;
+
+	if ((attr = entry->get(DW_AT_name)))
+		var->name.assign(attr->getString(), attr->getStringLength());
+
+	if ((attr = entry->get(DW_AT_location)))
+		processAddressAttr(attr, &var->address);
+
+	if ((attr = getTypeAttribute(entry)) && !processTypeAttr(attr, &var->type))
+		return error(std::string("Failed to processTypeAttr for variable '").append(var->name).append("'."));
+
+	return true;
+}
+
+bool processTypeAttr(Dwarf::Attribute *attr, Cpp::Type *type)
+{
+	Dwarf *dwarf = attr->entry->dwarf;
+
+	switch (attr->name)
+	{
+	case DW_AT_fund_type:
+	{
+		type->isFundamentalType = true;
+		type->fundamentalType = (Cpp::FundamentalType)attr->getHword();
+		break;
+	}
+	case DW_AT_user_def_type:
+	{
+		type->isFundamentalType = false;
+
+		if (!findUserType(dwarf, attr->getReference(), &type->userType))
+			return error(std::string("processTypeAttr failed when handling AT_user_def_type."));
+
+		break;
+	}
+	case DW_AT_mod_fund_type:
+	{
+		type->isFundamentalType = true;
+
+		char *mod = attr->getBlock();
+		char *end = mod + attr->size - sizeof(Elf32_Half);
+
+		type->fundamentalType = (Cpp::FundamentalType)dwarf->read<Elf32_Half>(end);
+
+		while (mod < end)
+		{
+			type->modifiers.push_back((Cpp::Type::Modifier)*mod);
+			mod++;
+		}
+
+		break;
+	}
+	case DW_AT_mod_u_d_type:
+	{
+		type->isFundamentalType = false;
+
+		char *mod = attr->getBlock();
+		char *end = mod + attr->size - sizeof(Elf32_Off);
+
+		if (!findUserType(dwarf, dwarf->read<Elf32_Off>(end), &type->userType))
+			return error(std::string("processTypeAttr failed when handling AT_mod_u_d_type."));
+
+		while (mod < end)
+		{
+			type->modifiers.push_back((Cpp::Type::Modifier)*mod);
+			mod++;
+		}
+
+		break;
+	}
+	}
+
+	return true;
+}
+
+bool processLocationAttr(Dwarf::Attribute *attr, int *location)
+{
+	// I don't really know how location is supposed to be handled,
+	// so I just look for a DW_OP_CONST and use that as the "location"
+
+	Dwarf *dwarf = attr->entry->dwarf;
+
+	char *block = attr->getBlock();
+	char *end = block + attr->size;
+
+	while (block < end)
+	{
+		char op = dwarf->read<char>(block);
+		block += sizeof(char);
+
+		if (op == DW_OP_CONST)
+		{
+			*location = dwarf->read<Elf32_Word>(block);
+			break;
+		}
+	}
+
+	return true;
+}
+
+bool processAddressAttr(Dwarf::Attribute *attr, unsigned int *address)
+{
+	Dwarf *dwarf = attr->entry->dwarf;
+
+	char *block = attr->getBlock();
+	char *end = block + attr->size;
+
+	while (block < end)
+	{
+		char op = dwarf->read<char>(block);
+		block += sizeof(char);
+
+		if (op == DW_OP_ADDR && end - block >= (ptrdiff_t)sizeof(Elf32_Addr))
+		{
+			*address = dwarf->read<Elf32_Addr>(block);
+			break;
+		}
+
+		// Only these operations have an operand
+		if (op >= DW_OP_REG && op <= DW_OP_CONST)
+			block += sizeof(Elf32_Word);
+	}
+
+	return true;
+}
+
+// Converts a type from a compile unit that was filtered out, and adds it to
+// the compile unit being converted, ahead of the type that needed it
+static bool pullInUserType(Dwarf::Entry *entry, Cpp::UserType **u)
+{
+	switch (entry->tag)
+	{
+	case DW_TAG_class_type:
+	case DW_TAG_structure_type:
+	case DW_TAG_enumeration_type:
+	case DW_TAG_array_type:
+	case DW_TAG_subroutine_type:
+	case DW_TAG_union_type:
+		break;
+	default:
+		return error(std::string("Reference to '").append(std::to_string(entry->offset)).append("' in a skipped compile unit isn't a type."));
+	}
+
+	// Registered first, so types that refer back to this one find it
+	Cpp::UserType *userType = new Cpp::UserType;
+	entryUTPairs[entry] = userType;
+
+	if (!processUserType(entry, userType))
+		return false;
+
+	userType->index = currentCppFile->userTypes.size();
+	currentCppFile->userTypes.push_back(userType);
+	nameUTListPairs[userType->name].push_back(userType);
+
+	*u = userType;
+
+	return true;
+}
+
+bool findUserType(Dwarf *dwarf, Elf32_Off ref, Cpp::UserType **u)
+{
+	Dwarf::Entry *entry = dwarf->getEntryFromReference(ref);
+
+	if (!entry && skippedTypeResolver && (*u = skippedTypeResolver(ref)))
+		return true;
+
+	if (!entry && currentCppFile && (entry = dwarf->loadEntry(ref)))
+		return pullInUserType(entry, u);
+
+	if (!entry || entryUTPairs.count(entry) == 0)
+		return error(std::string("Failed to findUserType for reference '").append(std::to_string(ref)).append("'."));
+
+	*u = entryUTPairs[entry];
+
+	return true;
+}
+
+bool processUserType(Dwarf::Entry *entry, Cpp::UserType *userType)
+{
+	Dwarf::Attribute *attr = entry->get(DW_AT_name);
+
+	if (attr)
+	{
+		char *name = attr->getString();
+		Elf32_Word length = attr->getStringLength();
+
+		if (attr->hasSpecial())
+			StrScan::replace(name, length, attr->firstSpecial, DWARF_SPECIAL_CHAR, '_');
+
+		userType->name.assign(name, length);
+	}
+
+	switch (entry->tag)
+	{
+	case DW_TAG_class_type:
+	case DW_TAG_structure_type:
+	case DW_TAG_union_type:
+		userType->type = (entry->tag == DW_TAG_structure_type) ? Cpp::UserType::STRUCT : ((entry->tag == DW_TAG_union_type) ? Cpp::UserType::UNION : Cpp::UserType::CLASS);
+		userType->classData = new Cpp::ClassType;
+		userType->classData->parent = userType;
+
+		if (!processClassType(entry, userType->classData))
+			return error(std::string("Failed to processClassType for user type '").append(userType->name).append("'."));
+
+		break;
+	case DW_TAG_enumeration_type:
+		userType->type = Cpp::UserType::ENUM;
+		userType->enumData = new Cpp::EnumType;
+
+		if (!processEnumType(entry, userType->enumData))
+			return error(std::string("Failed to processEnumType for user type '").append(userType->name).append("'."));
+
+		break;
+	case DW_TAG_array_type:
+		userType->type = Cpp::UserType::ARRAY;
+		userType->arrayData = new Cpp::ArrayType;
+
+		if (!processArrayType(entry, userType->arrayData))
+			return error(std::string("Failed to processArrayType for array type '").append(userType->name).append("'."));
+
+		break;
+	case DW_TAG_subroutine_type:
+		userType->type = Cpp::UserType::FUNCTION;
+		userType->functionData = new Cpp::FunctionType;
+
+		if (!processFunctionType(entry, userType->functionData))
+			return error(std::string("Failed to processFunctionType for function type '").append(userType->name).append("'."));
+
+		break;
+	}
+
+	return true;
+}
+
+bool processClassType(Dwarf::Entry *entry, Cpp::ClassType *c)
+{
+	Dwarf::Attribute *byteSize = entry->get(DW_AT_byte_size);
+
+	c->size = byteSize ? byteSize->getWord() : 0;
+
+	Dwarf::Entry *next = entry->getSibling();
+	Dwarf::Entry *first = entry;
+
+	int memberCount = 0;
+	entry++;
+
+	while (entry && entry < next)
+	{
+		if (entry->tag == DW_TAG_member)
+			memberCount++;
+
+		entry = entry->getSibling();
+	}
+
+	c->members.reserve(memberCount);
+	entry = first + 1;
+
+	while (entry && entry < next)
+	{
+		switch (entry->tag)
+		{
+		case DW_TAG_member:
+		{
+			Cpp::ClassType::Member m;
+
+			if (!processMember(entry, &m))
+				return error("Failed to processMember for class type.");
+
+			c->members.push_back(m);
+			break;
+		}
+		case DW_TAG_inheritance:
+			Cpp::ClassType::Inheritance i;
+
+			if (!processInheritance(entry, &i))
+				return error("Failed to processInheritance for class type.");
+
+			c->inheritances.push_back(i);
+			break;
+		}
+
+		entry = entry->getSibling();
+	}
+
+	return true;
+}
+
+bool processMember(Dwarf::Entry *entry, Cpp::ClassType::Member *m)
+{
+	Dwarf::Attribute *attr;
+
+	m->bit_offset = -1;
+	m->bit_size = -1;
+
+	if ((attr = entry->get(DW_AT_name)))
+		m->name.assign(attr->getString(), attr->getStringLength());
+
+	if ((attr = entry->get(DW_AT_bit_offset)))
+		m->bit_offset = attr->getHword();
+
+	if ((attr = entry->get(DW_AT_bit_size)))
+		m->bit_size = attr->getWord();
+
+	if ((attr = getTypeAttribute(entry)) && !processTypeAttr(attr, &m->type))
+		return error(std::string("Failed to processTypeAttr for member '").append(m->name).append("'."));
+
+	if ((attr = entry->get(DW_AT_location)) && !processLocationAttr(attr, &m->offset))
+		return error(std::string("Failed to processLocationAttr for member '").append(m->name).append("'."));
+
+	return true;
+}
+
+bool processInheritance(Dwarf::Entry *entry, Cpp::ClassType::Inheritance *i_)
+{
+	Dwarf::Attribute *attr;
+
+	if ((attr = entry->get(DW_AT_user_def_type)) && !processTypeAttr(attr, &i_->type))
+		return error("Failed to processTypeAttr for inheritance.");
+
+	if ((attr = entry->get(DW_AT_location)) && !processLocationAttr(attr, &i_->offset))
+		return error("Failed to processLocationAttr for inheritance.");
+
+	return true;
+}
+
+bool processEnumType(Dwarf::Entry *entry, Cpp::EnumType *e)
+{
+	int byte_size = 0;
+	Dwarf::Attribute *attr;
+
+	if ((attr = entry->get(DW_AT_byte_size)))
+	{
+		byte_size = attr->getWord();
+
+		switch (byte_size) {
+		case 1:
+			e->baseType = Cpp::FundamentalType::UNSIGNED_CHAR;
+			break;
+		case 2:
+			e->baseType = Cpp::FundamentalType::UNSIGNED_SHORT;
+			break;
+		case 4:
+			e->baseType = Cpp::FundamentalType::INT;
+			break;
+		case 8:
+			e->baseType = Cpp::FundamentalType::LONG;
+			break;
+		default:
+			return error(std::string("Unknown enum base type size for enum type. (Size: ").append(std::to_string(byte_size)).append(")"));
+			break;
+		}
+	}
+
+	if ((attr = entry->get(DW_AT_element_list)) && !processElementList(attr, e, byte_size))
+		return error("Failed to processElementList for enum type.");
+
+	return true;
+}
+
+bool processElementList(Dwarf::Attribute *attr, Cpp::EnumType *e, int byte_size)
+{
+	Dwarf *dwarf = attr->entry->dwarf;
+
+	char *block = attr->getBlock();
+	char *end = block + attr->size;
+
+	while (block < end)
+	{
+		Cpp::EnumType::Element element;
+
+		if (byte_size == 1) {
+			element.constValue = dwarf->read<unsigned char>(block);
+		}
+		else if (byte_size == 2) {
+			element.constValue = dwarf->read<unsigned short>(block);
+		}
+		else if (byte_size == 4) {
+			element.constValue = dwarf->read<int>(block);
+		}
+		else if (byte_size == 8) {
+			element.constValue = dwarf->read<long>(block);
+		}
+		
+		block += byte_size;
+
+		size_t length = StrScan::length(block);
+		element.name.assign(block, length);
+		block += length + 1;
+
+		e->elements.push_back(element);
+	}
+
+	return true;
+}
+
+bool processFunctionType(Dwarf::Entry *entry, Cpp::FunctionType *f)
+{
+	Dwarf::Entry *next = entry->getSibling();
+	Dwarf::Entry *first = entry;
+
+	int paramCount = 0;
+	entry++;
+
+	while (entry && entry < next)
+	{
+		if (entry->tag == DW_TAG_formal_parameter)
+			paramCount++;
+
+		entry = entry->getSibling();
+	}
+
+	f->parameters.reserve(paramCount);
+	entry = first;
+
+	Dwarf::Attribute *typeAttr = getTypeAttribute(entry);
+
+	if (typeAttr && !processTypeAttr(typeAttr, &f->returnType))
+		return error("Failed to processTypeAttr for function return type.");
+
+	entry++;
+
+	while (entry && entry < next)
+	{
+		switch (entry->tag)
+		{
+		case DW_TAG_formal_parameter:
+			Cpp::FunctionType::Parameter p;
+
+			if (!processParameter(entry, &p))
+				return error("Failed to processParameter for function parameter.");
+
+			f->parameters.push_back(p);
+		}
+
+		entry = entry->getSibling();
+	}
+
+	return true;
+}
+
+bool processParameter(Dwarf::Entry *entry, Cpp::FunctionType::Parameter *p)
+{
+	Dwarf::Attribute *attr;
+
+	if ((attr = entry->get(DW_AT_name)))
+		p->name.assign(attr->getString(), attr->getStringLength());
+
+	if ((attr = getTypeAttribute(entry)) && !processTypeAttr(attr, &p->type))
+		return error(std::string("Failed to processTypeAttr for parameter '").append(p->name).append("'."));
+
+	return true;
+}
+
+bool getMangledClassName(const std::string &mangledName, std::string *className)
+{
+	if (mangledName.size() <= 2)
+		return false;
+
+	size_t i = mangledName.find_last_of('_');
+
+	if (i == std::string::npos)
+		return false;
+
+	size_t length = 0;
+	size_t digits = 0;
+
+	for (i++; i < mangledName.size() && mangledName[i] >= '0' && mangledName[i] <= '9' && length <= mangledName.size(); i++, digits++)
+		length = length * 10 + (mangledName[i] - '0');
+
+	if (digits == 0 || length >= mangledName.size() - i || mangledName[i + length] != 'F')
+		return false;
+
+	className->assign(mangledName, i, length);
+	return true;
+}
+
+bool processFunction(Dwarf::Entry *entry, Cpp::Function *f)
+{
+	f->isGlobal = (entry->tag == DW_TAG_global_subroutine);
+	f->startAddress = 0;
+	f->endAddress = 0;
+	f->size = 0;
+
+	Dwarf::Attribute *attr;
+
+	if ((attr = entry->get(DW_AT_name)))
+		f->name.assign(attr->getString(), attr->getStringLength());
+
+	if ((attr = entry->get(DW_AT_mangled_name)))
+		f->mangledName.assign(attr->getString(), attr->getStringLength());
+
+	if ((attr = entry->get(DW_AT_low_pc)))
+		f->startAddress = attr->getAddress();
+
+	if ((attr = entry->get(DW_AT_high_pc)))
+		f->endAddress = attr->getAddress();
+
+	Dwarf::Entry *next = entry->getSibling();
+
+	entry++;
+
+	while (entry && entry < next)
+	{
+		switch (entry->tag)
+		{
+		case DW_TAG_lexical_block:
+			if (!processLexicalBlock(entry, f))
+				return error(std::string("Failed to processLexicalBlock for function '").append(f->name).append("'."));
+		}
+
+		entry = entry->getSibling();
+	}
+
+	std::string className;
+
+	f->typeOwner = nullptr;
+	if (f->parameters.size() > 0 && f->parameters[0].name.compare("this") == 0) {
+		f->typeOwner = f->parameters[0].type.userType;
+		f->parameters.erase(f->parameters.begin());
+		f->typeOwner->classData->functions.push_back(*f);
+	}
+	else if (getMangledClassName(f->mangledName, &className)) {
+		// I tried to access this from the named map, but I couldn't for the life of me figure out how to do it. C++ is terrible, no other languages have runtime libraries that silently fail like this. The map is empty even though the code that adds elements to the map is run. Good grief.
+		/*auto it = nameUTListPairs.find(className);
+		if (it != nameUTListPairs.end()) {
+			std::vector<Cpp::UserType*> vector = it->second;
+			if (vector.size() != 1)
+				std::cout << "Couldn't find good type for '" << className << "'. (" << vector.size() << ")" << std::endl;
+		}
+		else {
+			std::cout << "Couldn't find good type for '" << className << "'." << std::endl;
+		}*/
+
+		// Types of earlier compile units come first, see findLateMethods
+		Cpp::UserType* type = nullptr;
+		for (std::map<Dwarf::Entry*, Cpp::UserType*>::iterator iter = entryUTPairs.begin(); iter != entryUTPairs.end(); ++iter)
+		{
+			Cpp::UserType* value = iter->second;
+			if (value->name.compare(className) == 0) {
+				type = value;
+				break;
+			}
+		}
+
+		if (type != nullptr) {
+			f->typeOwner = type;
+			f->typeOwner->classData->functions.push_back(*f);
+		}
+	}
+
+	return true;
+}
+
+bool processLexicalBlock(Dwarf::Entry *entry, Cpp::Function *f)
+{
+	Dwarf::Entry *next = entry->getSibling();
+
+	entry++;
+
+	while (entry && entry < next)
+	{
+		switch (entry->tag)
+		{
+		case DW_TAG_global_variable:
+		case DW_TAG_local_variable:
+		{
+			Cpp::Variable v;
+			
+			if (!processVariable(entry, &v))
+				return error(std::string("Failed to processVariable for local var lexical block in function '").append(f->name).append("'."));
+
+			f->variables.push_back(v);
+			break;
+		}
+		}
+
+		entry = entry->getSibling();
+	}
+
+	return true;
+}
+
+bool processArrayType(Dwarf::Entry *entry, Cpp::ArrayType *a)
+{
+	Dwarf::Attribute *attr;
+
+	if ((attr = entry->get(DW_AT_ordering)) && attr->getHword() != DW_ORD_row_major) // meh
+		return error(std::string("processArrayType encountered ordering unsupported by dwarf2cpp! (").append(Cpp::toHexString(attr->getHword())).append(")"));
+
+	if ((attr = entry->get(DW_AT_subscr_data)) && !processSubscriptData(attr, a))
+		return error("Failed to processSubscriptData.");
+
+	return true;
+}
+
+bool processSubscriptData(Dwarf::Attribute *attr, Cpp::ArrayType *a)
+{
+	Dwarf *dwarf = attr->entry->dwarf;
+
+	char *block = attr->getBlock();
+	char *end = block + attr->size;
+
+	while (block < end)
+	{
+		char format = dwarf->read<char>(block);
+		block += sizeof(char);
+
+		if (format == DW_FMT_ET)
+		{
+			Dwarf::Attribute typeAttr;
+			Elf32_Off offset = dwarf->pointerToOffset(block);
+
+			offset = dwarf->decodeAttribute(offset, attr->entry, &typeAttr);
+			block = dwarf->offsetToPointer(offset);
+
+			if (!processTypeAttr(&typeAttr, &a->type))
+				return error("Failed to processTypeAttr for subscript data DW_FMT_ET.");
+
+			break;
+		}
+		else if (format == DW_FMT_FT_C_C)
+		{
+			Elf32_Half fundType = dwarf->read<Elf32_Half>(block);
+			block += sizeof(Elf32_Half);
+
+			// Only long indices are supported
+			if (fundType != DW_FT_long)
+				return error(std::string("Subscript data DW_FMT_FT_C_C had unsupported fundamental indice type ").append(Cpp::toHexString(fundType)).append(" in type '").append(a->toNameString("")).append("'."));
+
+			Elf32_Word lowBound = dwarf->read<Elf32_Word>(block);
+			block += sizeof(Elf32_Word);
+
+			// Only indices starting at 0 are supported
+			if (lowBound != 0)
+				return error(std::string("Subscript data contained indices which did not start at zero! (Start at: '").append(Cpp::toHexString(lowBound)).append("', Type: '").append(a->toNameString("")).append("')"));
+
+			Elf32_Word highBound = dwarf->read<Elf32_Word>(block);
+			block += sizeof(Elf32_Word);
+
+			Cpp::ArrayType::Dimension dimension;
+			dimension.size = highBound + 1;
+
+			a->dimensions.push_back(dimension);
+		}
+		else
+		{
+			// Only fundamental typed (long) indices and
+			// constant value bounds are supported
+			return error(std::string("Encountered subscript data format unsupported by dwarf2cpp! (").append(Cpp::toHexString(format)).append(")"));
+		}
+	}
+
+	return true;
+}
\ No newline at end of file
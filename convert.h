@@ -0,0 +1,97 @@
+#pragma once
+
+#include "dwarf.h"
+#include "cpp.h"
+#include "symtab.h"
+#include "filter.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <unordered_map>
+
+// Every attribute the conversion looks at. Anything else is skipped by the parser.
+extern const uint64_t usedAttributes;
+
+// Selects the compile units, types and functions that are converted. Set it
+// up before converting anything.
+extern ExtractFilter extractFilter;
+
+// Conversion state is kept per thread, so that separate programs can be
+// converted in parallel.
+extern thread_local std::vector<Cpp::File*> cppFiles;
+extern thread_local std::map<Dwarf::Entry*, Cpp::UserType*> entryUTPairs;
+
+// Resolves references into compile units that were skipped because they were
+// converted earlier (see WatchSession), before the entry is read on demand.
+extern thread_local std::function<Cpp::UserType*(Elf32_Off ref)> skippedTypeResolver;
+
+// Returns the files converted so far on this thread and resets the conversion state.
+std::vector<Cpp::File*> takeConvertedFiles();
+
+// Loads an ELF file and converts its DWARF data into cppFiles, printing progress
+// along the way. Returns the parsed DWARF data, or nullptr on failure. The
+// file's symbol table is applied to the functions, and handed over through
+// outSymbols if given.
+Dwarf* convertElfFile(const char *filename, SymbolTable **outSymbols = nullptr);
+
+// The filter for Dwarf that skips compile units extractFilter leaves out,
+// or none if it doesn't filter compile units
+Dwarf::CompileUnitFilter getCompileUnitFilter();
+
+// Fills in function sizes, and the end addresses and (if fillAddresses is set)
+// start addresses that the DWARF data is missing, from the symbol table.
+// Variable addresses are filled in too if fillAddresses is set.
+void applySymbolTable(std::vector<Cpp::File*> &files, const SymbolTable &symbols, bool fillAddresses);
+
+bool error(std::string errorMessage);
+void logMessage(std::string message);
+
+Cpp::File* findCppFile(Dwarf::Entry *entry, const char **outFilename);
+void fixUserTypeNames();
+
+bool processDwarf(Dwarf *dwarf);
+
+// Converts one compile unit, adding it to cppFiles or to the file of an earlier
+// compile unit with the same name. Returns that file, or nullptr on failure.
+Cpp::File* convertCompileUnit(Dwarf::Entry *entry);
+
+// Where compile units add methods to the classes of earlier ones, which
+// processFunction does through a function's this parameter, or by the class
+// name in its mangled name, taking the first class converted with that name.
+// Compile units are numbered by their position in units.
+struct LateMethods
+{
+	// The last compile unit with a function whose mangled name has each class name
+	std::unordered_map<std::string, size_t> lastByClassName;
+
+	// The last compile unit with a this parameter pointing into each one, or the compile unit itself
+	std::vector<size_t> lastByTarget;
+};
+
+// Finds them before the compile units, given as the indexes of their entries
+// in order, are parsed. Subroutines and parameters anywhere in a compile unit
+// are looked at, so the result can overestimate.
+LateMethods findLateMethods(Dwarf *dwarf, const std::vector<int> &units);
+
+bool getMangledClassName(const std::string &mangledName, std::string *className);
+
+bool processCompileUnit(Dwarf::Entry *entry, Cpp::File *cpp);
+bool processVariable(Dwarf::Entry *entry, Cpp::Variable *var);
+bool processTypeAttr(Dwarf::Attribute *attr, Cpp::Type *type);
+bool processLocationAttr(Dwarf::Attribute *attr, int *location);
+bool processAddressAttr(Dwarf::Attribute *attr, unsigned int *address);
+bool findUserType(Dwarf *dwarf, Elf32_Off ref, Cpp::UserType **u);
+bool processUserType(Dwarf::Entry *entry, Cpp::UserType *u);
+bool processClassType(Dwarf::Entry *entry, Cpp::ClassType *c);
+bool processMember(Dwarf::Entry *entry, Cpp::ClassType::Member *m);
+bool processInheritance(Dwarf::Entry *entry, Cpp::ClassType::Inheritance *i_);
+bool processEnumType(Dwarf::Entry *entry, Cpp::EnumType *e);
+bool processElementList(Dwarf::Attribute *attr, Cpp::EnumType *e, int byte_size);
+bool processFunctionType(Dwarf::Entry *entry, Cpp::FunctionType *f);
+bool processParameter(Dwarf::Entry *entry, Cpp::FunctionType::Parameter *p);
+bool processFunction(Dwarf::Entry *entry, Cpp::Function *f);
+bool processLexicalBlock(Dwarf::Entry *entry, Cpp::Function *f);
+bool processArrayType(Dwarf::Entry *entry, Cpp::ArrayType *a);
+bool processSubscriptData(Dwarf::Attribute *attr, Cpp::ArrayType *a);
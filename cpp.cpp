@@ -1,8 +1,10 @@
 #include "cpp.h"
 
+#include <algorithm>
+
 namespace Cpp
 {
-static inline std::string toHexString(int x)
+std::string toHexString(int x)
 {
 	std::stringstream ss;
 	ss << std::hex << std::showbase << x;
@@ -96,9 +98,10 @@ std::string Type::toString(std::string varName) {
 	std::stringstream result;
 
 	// Add prefix modifiers.
-	for (Modifier mod : modifiers)
-		if (mod == Modifier::CONST || mod == Modifier::VOLATILE)
-			result << ModifierToString(mod) << " ";
+	if (modifiers.hasQualifier())
+		for (Modifier mod : modifiers)
+			if (mod == Modifier::CONST || mod == Modifier::VOLATILE)
+				result << ModifierToString(mod) << " ";
 
 	if (isFundamentalType) {
 		result << FundamentalTypeToString(fundamentalType);
@@ -112,9 +115,10 @@ std::string Type::toString(std::string varName) {
 		result << userType->name;
 	}
 
-	for (Modifier mod : modifiers)
-		if (mod == Modifier::POINTER_TO || mod == Modifier::REFERENCE_TO)
-			result << ModifierToString(mod);
+	if (modifiers.hasPointer())
+		for (Modifier mod : modifiers)
+			if (mod == Modifier::POINTER_TO || mod == Modifier::REFERENCE_TO)
+				result << ModifierToString(mod);
 
 	if (!varName.empty())
 		result << " " << varName;
@@ -182,6 +186,27 @@ std::string UserType::toNameString(bool includeSize, bool includeInheritances)
 	return "<unknown user type (" + toHexString(type) + ")>";
 }
 
+std::string UserType::toKindString()
+{
+	switch (type)
+	{
+	case CLASS:
+		return "class";
+	case UNION:
+		return "union";
+	case STRUCT:
+		return "struct";
+	case ENUM:
+		return "enum";
+	case ARRAY:
+		return "array";
+	case FUNCTION:
+		return "function";
+	}
+
+	return "unknown";
+}
+
 std::string ClassType::toNameString(std::string name, bool includeSize, bool includeInheritances)
 {
 	std::stringstream ss;
@@ -395,19 +420,23 @@ std::string Function::toDefinitionString()
 {
 	std::stringstream ss;
 	ss << CommentToString(mangledName) <<
-		CommentToString("Start address: " + toHexString(startAddress)) <<
-		toNameString() << "\n{\n";
+		CommentToString("Start address: " + toHexString(startAddress));
+
+	if (size != 0)
+		ss << CommentToString("Size: " + toHexString(size));
+
+	ss << toNameString() << "\n{\n";
 
 	for (Variable &v : variables)
 		ss << "\t" << v.toString() << ";\n";
 
 	// Save line numbers.
 	if (dwarf != nullptr) {
-		std::multimap<int, Dwarf::LineEntry>::iterator lines = dwarf->lineEntryMap.find(startAddress);
+		Dwarf::LineEntryMap::iterator lines = dwarf->lineEntryMap.find(startAddress);
 		if (lines != dwarf->lineEntryMap.end()) {
-			std::pair<std::multimap<int, Dwarf::LineEntry>::iterator, std::multimap<int, Dwarf::LineEntry>::iterator> ret;
+			std::pair<Dwarf::LineEntryMap::iterator, Dwarf::LineEntryMap::iterator> ret;
 			ret = dwarf->lineEntryMap.equal_range(startAddress);
-			for (std::multimap<int, Dwarf::LineEntry>::iterator it = ret.first; it != ret.second; ++it) {
+			for (Dwarf::LineEntryMap::iterator it = ret.first; it != ret.second; ++it) {
 				ss << "\t// ";
 				if (it->second.lineNumber != 0) {
 					ss << "Line " << it->second.lineNumber;
@@ -474,77 +503,187 @@ std::string FundamentalTypeToString(FundamentalType ft)
 	return ss.str();
 }
 
+// Indexed by fundamental type, -1 where there is no such type
+static const int FundamentalTypeSizes[] =
+{
+	-1,
+	1, 1, 1,    // CHAR, SIGNED_CHAR, UNSIGNED_CHAR
+	2, 2, 2,    // SHORT, SIGNED_SHORT, UNSIGNED_SHORT
+	4, 4, 4,    // INT, SIGNED_INT, UNSIGNED_INT
+	8, 8, 8,    // LONG, SIGNED_LONG, UNSIGNED_LONG (Confirmed 8 bytes.)
+	-1,
+	4,          // FLOAT
+	8,          // DOUBLE
+	8,          // LONG_DOUBLE (TODO: UNSURE)
+	-1, -1, -1,
+	4,          // VOID (TODO: UNSURE)
+	1           // BOOL (TODO: UNSURE)
+};
+
 int GetFundamentalTypeSize(FundamentalType ft)
 {
-	switch (ft)
-	{
-	case FundamentalType::CHAR:
-	case FundamentalType::SIGNED_CHAR:
-	case FundamentalType::UNSIGNED_CHAR:
-		return 1;
-	case FundamentalType::SHORT:
-	case FundamentalType::SIGNED_SHORT:
-	case FundamentalType::UNSIGNED_SHORT:
-		return 2;
-	case FundamentalType::INT:
-	case FundamentalType::SIGNED_INT:
-	case FundamentalType::UNSIGNED_INT:
-		return 4;
-	case FundamentalType::LONG:
-	case FundamentalType::SIGNED_LONG:
-	case FundamentalType::UNSIGNED_LONG:
-		return 8; // Confirmed 8 bytes.
-	case FundamentalType::FLOAT:
-		return 4;
-	case FundamentalType::DOUBLE:
+	if ((unsigned int)ft < sizeof(FundamentalTypeSizes) / sizeof(int))
+		return FundamentalTypeSizes[ft];
+
+	// TODO: UNSURE
+	if (ft == FundamentalType::LONG_LONG ||
+		ft == FundamentalType::SIGNED_LONG_LONG ||
+		ft == FundamentalType::UNSIGNED_LONG_LONG)
 		return 8;
-	case FundamentalType::LONG_DOUBLE:
-		return 8; // TODO: UNSURE
-	case FundamentalType::VOID:
-		return 4; // TODO: UNSURE
-	case FundamentalType::BOOL:
-		return 1; // TODO: UNSURE
-	case FundamentalType::LONG_LONG:
-	case FundamentalType::SIGNED_LONG_LONG:
-	case FundamentalType::UNSIGNED_LONG_LONG:
-		return 8; // TODO: UNSURE
-	}
 
 	return -1;
 }
 
-int Type::size() {
-	if (modifiers.size() > 0)
-		for (Cpp::Type::Modifier modifier : modifiers)
-			if (modifier == Cpp::Type::Modifier::POINTER_TO || modifier == Cpp::Type::Modifier::REFERENCE_TO)
-				return 4;
+bool Type::isPointer()
+{
+	return modifiers.hasPointer();
+}
 
-	if (isFundamentalType) {
+int Type::size()
+{
+	if (isPointer())
+		return 4;
+
+	if (isFundamentalType)
 		return GetFundamentalTypeSize(fundamentalType);
+
+	return userType->getLayout().size;
+}
+
+int Type::alignment()
+{
+	if (isPointer())
+		return 4;
+
+	if (isFundamentalType)
+	{
+		int size = GetFundamentalTypeSize(fundamentalType);
+		return (size > 0) ? size : 1;
 	}
-	else {
-		switch (userType->type) {
-		case Cpp::UserType::STRUCT:
-		case Cpp::UserType::CLASS:
-		case Cpp::UserType::UNION:
-			return userType->classData->size;
-			break;
-		case Cpp::UserType::ARRAY:
-			int amount;
-			amount = 1;
-			if (userType->arrayData->dimensions.size() > 0)
-				for (auto dimension : userType->arrayData->dimensions)
-					amount *= dimension.size;
-			return amount * userType->arrayData->type.size();
-			break;
-		case Cpp::UserType::FUNCTION:
-			return 4;
-			break;
-		case Cpp::UserType::ENUM:
-			return GetFundamentalTypeSize(userType->enumData->baseType);
-			break;
+
+	return userType->getLayout().alignment;
+}
+
+const Layout& UserType::getLayout()
+{
+	if (layout)
+		return *layout;
+
+	// A type can't contain itself by value, but bad data could make it look like it does
+	static const Layout invalid = { 0, 1, {}, {}, {} };
+
+	if (computingLayout)
+		return invalid;
+
+	computingLayout = true;
+
+	Layout *l = new Layout;
+	l->size = 0;
+	l->alignment = 1;
+
+	switch (type)
+	{
+	case STRUCT:
+	case CLASS:
+	case UNION:
+		computeClassLayout(l);
+		break;
+	case ARRAY:
+	{
+		int amount = 1;
+
+		for (ArrayType::Dimension &dimension : arrayData->dimensions)
+			amount *= dimension.size;
+
+		l->size = amount * arrayData->type.size();
+		l->alignment = arrayData->type.alignment();
+		break;
+	}
+	case FUNCTION:
+		l->size = 4;
+		l->alignment = 4;
+		break;
+	case ENUM:
+		l->size = GetFundamentalTypeSize(enumData->baseType);
+		l->alignment = (l->size > 0) ? l->size : 1;
+		break;
+	}
+
+	computingLayout = false;
+	layout = l;
+
+	return *layout;
+}
+
+void UserType::computeClassLayout(Layout *l)
+{
+	l->size = classData->size;
+
+	// Byte ranges covered by base classes and members, used to find the holes
+	std::vector<std::pair<int, int>> covered;
+
+	for (ClassType::Inheritance &i : classData->inheritances)
+	{
+		int size = i.type.size();
+		int alignment = i.type.alignment();
+
+		if (alignment > l->alignment)
+			l->alignment = alignment;
+
+		if (size > 0)
+			covered.push_back(std::make_pair(i.offset, i.offset + size));
+	}
+
+	Vector<ClassType::Member> &members = classData->members;
+	l->members.reserve(members.size());
+
+	for (size_t i = 0; i < members.size(); i++)
+	{
+		ClassType::Member &m = members[i];
+		Layout::MemberLayout ml = { m.offset, m.type.size(), m.type.alignment() };
+
+		l->members.push_back(ml);
+
+		if (ml.alignment > l->alignment)
+			l->alignment = ml.alignment;
+
+		if (ml.size > 0)
+			covered.push_back(std::make_pair(ml.offset, ml.offset + ml.size));
+
+		if (m.bit_size != -1)
+		{
+			if (!l->bitfields.empty())
+			{
+				Layout::BitfieldSpan &span = l->bitfields.back();
+
+				if (span.lastMember == (int)i - 1 && span.offset == m.offset)
+				{
+					span.lastMember = i;
+					span.bitsUsed += m.bit_size;
+					continue;
+				}
+			}
+
+			Layout::BitfieldSpan span = { m.offset, ml.size, (int)i, (int)i, m.bit_size };
+			l->bitfields.push_back(span);
 		}
 	}
+
+	std::sort(covered.begin(), covered.end());
+
+	int end = 0;
+
+	for (std::pair<int, int> &range : covered)
+	{
+		if (range.first > end)
+			l->holes.push_back({ end, range.first - end });
+
+		if (range.second > end)
+			end = range.second;
+	}
+
+	if (l->size > end)
+		l->holes.push_back({ end, l->size - end });
 }
 
 std::string Type::ModifierToString(Modifier m)
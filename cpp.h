@@ -1,6 +1,7 @@
 #pragma once
 
 #include "dwarf.h"
+#include "memstats.h"
 #include <vector>
 #include <map>
 #include <string>
@@ -17,6 +18,11 @@ struct EnumType;
 struct ArrayType;
 struct FunctionType;
 struct Function;
+struct Layout;
+
+// Containers of the C++ model, counted towards MEM_CPP_MODEL
+template<typename T>
+using Vector = std::vector<T, CountingAllocator<T, MEM_CPP_MODEL>>;
 
 enum FundamentalType
 {
@@ -45,9 +51,9 @@ enum FundamentalType
 struct File
 {
 	std::string filename;
-	std::vector<Variable> variables;
-	std::vector<UserType*> userTypes;
-	std::vector<Function> functions;
+	Vector<Variable> variables;
+	Vector<UserType*> userTypes;
+	Vector<Function> functions;
 
 	std::string toString(bool justUserTypes, bool includeComments);
 };
@@ -62,8 +68,137 @@ struct Type
 		VOLATILE = 0x3
 	};
 
+	// Modifiers in the order DWARF lists them. Up to INLINE_COUNT of them are
+	// packed two bits each into one word, which covers nearly every type
+	// without an allocation. Longer chains, and values from bad data that
+	// don't fit in two bits, move to the heap.
+	class ModifierList
+	{
+	public:
+		enum { INLINE_COUNT = 16 };
+
+		class const_iterator
+		{
+		public:
+			const_iterator(const ModifierList *list, size_t i) : m_list(list), m_i(i)
+			{
+			}
+
+			inline Modifier operator*() const { return (*m_list)[m_i]; }
+			inline const_iterator& operator++() { m_i++; return *this; }
+			inline bool operator!=(const const_iterator &other) const { return m_i != other.m_i; }
+
+		private:
+			const ModifierList *m_list;
+			size_t m_i;
+		};
+
+		ModifierList() = default;
+
+		ModifierList(const ModifierList &other) : m_bits(other.m_bits), m_count(other.m_count),
+			m_heap(other.m_heap ? new Vector<Modifier>(*other.m_heap) : nullptr)
+		{
+		}
+
+		ModifierList(ModifierList &&other) noexcept : m_bits(other.m_bits), m_count(other.m_count), m_heap(other.m_heap)
+		{
+			other.m_bits = 0;
+			other.m_count = 0;
+			other.m_heap = nullptr;
+		}
+
+		ModifierList& operator=(ModifierList other) noexcept
+		{
+			std::swap(m_bits, other.m_bits);
+			std::swap(m_count, other.m_count);
+			std::swap(m_heap, other.m_heap);
+			return *this;
+		}
+
+		~ModifierList()
+		{
+			delete m_heap;
+		}
+
+		inline void push_back(Modifier m)
+		{
+			if (!m_heap && m_count < INLINE_COUNT && (unsigned int)m <= 3)
+				m_bits |= (uint32_t)m << (m_count * 2);
+			else
+			{
+				if (!m_heap)
+					spill();
+
+				m_heap->push_back(m);
+			}
+
+			m_count++;
+		}
+
+		inline size_t size() const { return m_count; }
+		inline bool empty() const { return m_count == 0; }
+
+		inline Modifier operator[](size_t i) const
+		{
+			return m_heap ? (*m_heap)[i] : (Modifier)((m_bits >> (i * 2)) & 3);
+		}
+
+		inline const_iterator begin() const { return const_iterator(this, 0); }
+		inline const_iterator end() const { return const_iterator(this, m_count); }
+
+		// Whether any modifier is POINTER_TO or REFERENCE_TO, the values whose two bits differ
+		inline bool hasPointer() const
+		{
+			if (m_heap)
+				return contains(POINTER_TO) || contains(REFERENCE_TO);
+
+			return ((m_bits ^ (m_bits >> 1)) & 0x55555555 & usedBits()) != 0;
+		}
+
+		// Whether any modifier is CONST or VOLATILE, the values whose two bits are the same
+		inline bool hasQualifier() const
+		{
+			if (m_heap)
+				return contains(CONST) || contains(VOLATILE);
+
+			return (~(m_bits ^ (m_bits >> 1)) & 0x55555555 & usedBits()) != 0;
+		}
+
+	private:
+		uint32_t m_bits = 0;
+		uint32_t m_count = 0;
+		Vector<Modifier> *m_heap = nullptr;
+
+		inline uint32_t usedBits() const
+		{
+			return (m_count >= INLINE_COUNT) ? 0xffffffff : (1u << (m_count * 2)) - 1;
+		}
+
+		bool contains(Modifier m) const
+		{
+			for (Modifier modifier : *m_heap)
+			{
+				if (modifier == m)
+					return true;
+			}
+
+			return false;
+		}
+
+		void spill()
+		{
+			m_heap = new Vector<Modifier>();
+			m_heap->reserve(m_count + 1);
+
+			for (size_t i = 0; i < m_count; i++)
+				m_heap->push_back((Modifier)((m_bits >> (i * 2)) & 3));
+
+			m_bits = 0;
+		}
+	};
+
 	bool isFundamentalType;
-	std::vector<Modifier> modifiers;
+	ModifierList modifiers;
 
 	union
 	{
@@ -72,6 +207,8 @@ struct Type
 	};
 
 	int size();
+	int alignment();
+	bool isPointer();
 	std::string toString(std::string varName);
 	std::string toString();
 	static std::string ModifierToString(Modifier m);
@@ -82,15 +219,53 @@ struct Variable
 	std::string name;
 	bool isGlobal;
 	Type type;
+	unsigned int address; // 0 unless the variable is static
 
 	std::string toString();
 };
 
+// Size and placement information of a user type, computed once on demand.
+struct Layout
+{
+	struct MemberLayout
+	{
+		int offset;
+		int size;
+		int alignment;
+	};
+
+	// Bytes not covered by any member or base class
+	struct Hole
+	{
+		int offset;
+		int size;
+	};
+
+	// A run of bitfield members sharing one storage unit
+	struct BitfieldSpan
+	{
+		int offset;
+		int size;
+		int firstMember;
+		int lastMember;
+		int bitsUsed;
+	};
+
+	int size;
+	int alignment;
+	Vector<MemberLayout> members;
+	Vector<Hole> holes;
+	Vector<BitfieldSpan> bitfields;
+};
+
 struct UserType
 {
 	enum { CLASS, UNION, STRUCT, ENUM, ARRAY, FUNCTION } type;
 	std::string name;
 	int index;
+	bool anonymous = false;
+	Layout *layout = nullptr;
+	bool computingLayout = false;
 
 	union
 	{
@@ -103,6 +278,14 @@ struct UserType
 	std::string toDeclarationString();
 	std::string toDefinitionString(bool includeComments);
 	std::string toNameString(bool includeSize, bool includeInheritances);
+	std::string toKindString();
+	// Computed on first use and cached without synchronization. Conversion
+	// computes the layout of every type it creates, so once a file has been
+	// converted this only reads.
+	const Layout& getLayout();
+
+private:
+	void computeClassLayout(Layout *l);
 };
 
 struct ClassType
@@ -126,9 +309,9 @@ struct ClassType
 
 	UserType* parent;
 	int size;
-	std::vector<Member> members;
-	std::vector<Inheritance> inheritances;
-	std::vector<Function> functions;
+	Vector<Member> members;
+	Vector<Inheritance> inheritances;
+	Vector<Function> functions;
 
 	std::string toNameString(std::string name, bool includeSize, bool includeInheritances);
 	std::string toBodyString(bool includeOffsets);
@@ -146,7 +329,7 @@ struct EnumType
 	};
 
 	FundamentalType baseType;
-	std::vector<Element> elements;
+	Vector<Element> elements;
 
 	std::string toNameString(std::string name);
 	std::string toBodyString();
@@ -160,7 +343,7 @@ struct ArrayType
 	};
 
 	Type type;
-	std::vector<Dimension> dimensions;
+	Vector<Dimension> dimensions;
 
 	std::string toNameString(std::string name);
 };
@@ -176,7 +359,7 @@ struct FunctionType
 	};
 
 	Type returnType;
-	std::vector<Parameter> parameters;
+	Vector<Parameter> parameters;
 
 	std::string toNameString(std::string name);
 	std::string toParametersString();
@@ -189,7 +372,9 @@ struct Function : FunctionType
 	std::string name;
 	std::string mangledName;
 	unsigned int startAddress;
-	std::vector<Variable> variables;
+	unsigned int endAddress;
+	unsigned int size;
+	Vector<Variable> variables;
 	UserType* typeOwner;
 	Dwarf* dwarf;
 
@@ -204,4 +389,5 @@ int GetFundamentalTypeSize(FundamentalType ft);
 std::string CommentToString(std::string comment);
 std::string StarCommentToString(std::string comment, bool multiline);
 std::string IndentToString(int level);
+std::string toHexString(int x);
 }
\ No newline at end of file
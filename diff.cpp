@@ -0,0 +1,352 @@
+#include "diff.h"
+#include "convert.h"
+#include "hash.h"
+
+#include <algorithm>
+
+static bool sameVariants(std::vector<uint64_t> a, std::vector<uint64_t> b)
+{
+	if (a.size() != b.size())
+		return false;
+
+	if (a.size() == 1)
+		return a[0] == b[0];
+
+	std::sort(a.begin(), a.end());
+	std::sort(b.begin(), b.end());
+
+	return a == b;
+}
+
+static std::string memberToString(Cpp::ClassType::Member &m)
+{
+	return m.toString(false) + " @ " + Cpp::toHexString(m.offset);
+}
+
+ProgramDiff::ProgramDiff(std::vector<Cpp::File*> &oldFiles, std::vector<Cpp::File*> &newFiles)
+{
+	index(oldFiles, &m_old);
+	index(newFiles, &m_new);
+}
+
+void ProgramDiff::index(std::vector<Cpp::File*> &files, Program *program)
+{
+	for (Cpp::File *cpp : files)
+	{
+		for (Cpp::UserType *ut : cpp->userTypes)
+		{
+			// Anonymous types only have generated names, so they're compared
+			// through the types that use them instead
+			if (ut->anonymous || ut->type == Cpp::UserType::ARRAY || ut->type == Cpp::UserType::FUNCTION)
+				continue;
+
+			std::string key = ut->toKindString() + " " + ut->name;
+			uint64_t hash = hashUserType(ut);
+
+			auto it = program->types.find(key);
+
+			if (it == program->types.end())
+			{
+				program->typeOrder.push_back(key);
+				program->types[key] = { { hash }, { ut } };
+			}
+			else if (std::find(it->second.hashes.begin(), it->second.hashes.end(), hash) == it->second.hashes.end())
+			{
+				it->second.hashes.push_back(hash);
+				it->second.types.push_back(ut);
+			}
+		}
+
+		for (Cpp::Function &fun : cpp->functions)
+		{
+			std::string key = fun.mangledName.empty() ? fun.name : fun.mangledName;
+			uint64_t hash = hashFunction(fun);
+
+			auto it = program->functions.find(key);
+
+			if (it == program->functions.end())
+			{
+				program->functionOrder.push_back(key);
+				program->functions[key] = { { hash }, { &fun } };
+			}
+			else if (std::find(it->second.hashes.begin(), it->second.hashes.end(), hash) == it->second.hashes.end())
+			{
+				it->second.hashes.push_back(hash);
+				it->second.functions.push_back(&fun);
+			}
+		}
+	}
+}
+
+ProgramDiff::Summary ProgramDiff::write(std::ostream &out)
+{
+	Summary summary;
+
+	out << "Types:" << std::endl;
+
+	for (const std::string &key : m_new.typeOrder)
+	{
+		TypeVariants &after = m_new.types[key];
+		auto it = m_old.types.find(key);
+
+		if (it == m_old.types.end())
+		{
+			out << "  + " << after.types[0]->toNameString(true, true) << std::endl;
+			summary.typesAdded++;
+			continue;
+		}
+
+		TypeVariants &before = it->second;
+
+		if (sameVariants(before.hashes, after.hashes))
+			continue;
+
+		summary.typesChanged++;
+		out << "  ~ " << after.types[0]->toNameString(true, true);
+
+		if (before.types.size() != 1 || after.types.size() != 1)
+			out << " (" << before.types.size() << " -> " << after.types.size() << " distinct definitions)";
+
+		out << std::endl;
+		writeTypeChanges(out, before.types[0], after.types[0]);
+	}
+
+	for (const std::string &key : m_old.typeOrder)
+	{
+		if (m_new.types.count(key) == 0)
+		{
+			out << "  - " << m_old.types[key].types[0]->toNameString(true, true) << std::endl;
+			summary.typesRemoved++;
+		}
+	}
+
+	out << std::endl << "Functions:" << std::endl;
+
+	for (const std::string &key : m_new.functionOrder)
+	{
+		FunctionVariants &after = m_new.functions[key];
+		auto it = m_old.functions.find(key);
+
+		if (it == m_old.functions.end())
+		{
+			out << "  + " << after.functions[0]->toNameString() << std::endl;
+			summary.functionsAdded++;
+			continue;
+		}
+
+		FunctionVariants &before = it->second;
+
+		if (sameVariants(before.hashes, after.hashes))
+			continue;
+
+		summary.functionsChanged++;
+		out << "  ~ " << before.functions[0]->toNameString() << std::endl;
+		out << "    -> " << after.functions[0]->toNameString() << std::endl;
+	}
+
+	for (const std::string &key : m_old.functionOrder)
+	{
+		if (m_new.functions.count(key) == 0)
+		{
+			out << "  - " << m_old.functions[key].functions[0]->toNameString() << std::endl;
+			summary.functionsRemoved++;
+		}
+	}
+
+	out << std::endl << "Summary:" << std::endl;
+	out << "\tTypes: " << summary.typesAdded << " added, " << summary.typesRemoved << " removed, " << summary.typesChanged << " changed" << std::endl;
+	out << "\tFunctions: " << summary.functionsAdded << " added, " << summary.functionsRemoved << " removed, " << summary.functionsChanged << " changed" << std::endl;
+
+	return summary;
+}
+
+void ProgramDiff::writeTypeChanges(std::ostream &out, Cpp::UserType *before, Cpp::UserType *after)
+{
+	if (before->type != after->type)
+		return;
+
+	if (before->type == Cpp::UserType::ENUM)
+	{
+		std::unordered_map<std::string, long> values;
+
+		for (Cpp::EnumType::Element &e : before->enumData->elements)
+			values[e.name] = e.constValue;
+
+		for (Cpp::EnumType::Element &e : after->enumData->elements)
+		{
+			auto it = values.find(e.name);
+
+			if (it == values.end())
+				out << "      + " << e.name << " = " << Cpp::toHexString(e.constValue) << std::endl;
+			else
+			{
+				if (it->second != e.constValue)
+					out << "      ~ " << e.name << " = " << Cpp::toHexString(it->second) << " -> " << Cpp::toHexString(e.constValue) << std::endl;
+
+				values.erase(it);
+			}
+		}
+
+		for (Cpp::EnumType::Element &e : before->enumData->elements)
+		{
+			if (values.count(e.name))
+				out << "      - " << e.name << " = " << Cpp::toHexString(e.constValue) << std::endl;
+		}
+
+		return;
+	}
+
+	Cpp::ClassType *b = before->classData;
+	Cpp::ClassType *a = after->classData;
+
+	if (b->size != a->size)
+		out << "      size " << Cpp::toHexString(b->size) << " -> " << Cpp::toHexString(a->size) << std::endl;
+
+	// Unnamed members are matched by offset
+	auto keyOf = [](Cpp::ClassType::Member &m) { return m.name.empty() ? "@" + std::to_string(m.offset) : m.name; };
+
+	std::unordered_map<std::string, Cpp::ClassType::Member*> members;
+
+	for (Cpp::ClassType::Member &m : b->members)
+		members[keyOf(m)] = &m;
+
+	for (Cpp::ClassType::Member &m : a->members)
+	{
+		auto it = members.find(keyOf(m));
+
+		if (it == members.end())
+			out << "      + " << memberToString(m) << std::endl;
+		else
+		{
+			std::string was = memberToString(*it->second);
+			std::string is = memberToString(m);
+
+			if (was != is)
+				out << "      ~ " << was << " -> " << is << std::endl;
+
+			members.erase(it);
+		}
+	}
+
+	for (Cpp::ClassType::Member &m : b->members)
+	{
+		if (members.count(keyOf(m)))
+			out << "      - " << memberToString(m) << std::endl;
+	}
+}
+
+uint64_t ProgramDiff::hashUserType(Cpp::UserType *ut)
+{
+	auto it = m_hashes.find(ut);
+
+	if (it != m_hashes.end())
+		return it->second;
+
+	// Stops a type that (indirectly) refers to itself from recursing forever
+	m_hashes[ut] = 0;
+
+	uint64_t h = hashMix(FNV_OFFSET, (uint64_t)ut->type);
+
+	if (!ut->anonymous)
+		h = hashMix(h, ut->name);
+
+	switch (ut->type)
+	{
+	case Cpp::UserType::CLASS:
+	case Cpp::UserType::STRUCT:
+	case Cpp::UserType::UNION:
+		h = hashMix(h, (uint64_t)ut->classData->size);
+
+		for (Cpp::ClassType::Inheritance &i : ut->classData->inheritances)
+			h = hashMix(hashType(i.type, h), (uint64_t)i.offset);
+
+		for (Cpp::ClassType::Member &m : ut->classData->members)
+		{
+			h = hashMix(h, m.name);
+			h = hashMix(h, (uint64_t)m.offset);
+			h = hashMix(h, (uint64_t)m.bit_offset);
+			h = hashMix(h, (uint64_t)m.bit_size);
+			h = hashType(m.type, h);
+		}
+
+		break;
+	case Cpp::UserType::ENUM:
+		h = hashMix(h, (uint64_t)ut->enumData->baseType);
+
+		for (Cpp::EnumType::Element &e : ut->enumData->elements)
+			h = hashMix(hashMix(h, e.name), (uint64_t)e.constValue);
+
+		break;
+	case Cpp::UserType::ARRAY:
+		h = hashType(ut->arrayData->type, h);
+
+		for (Cpp::ArrayType::Dimension &d : ut->arrayData->dimensions)
+			h = hashMix(h, (uint64_t)d.size);
+
+		break;
+	case Cpp::UserType::FUNCTION:
+		h = hashType(ut->functionData->returnType, h);
+
+		for (Cpp::FunctionType::Parameter &p : ut->functionData->parameters)
+			h = hashType(p.type, hashMix(h, p.name));
+
+		break;
+	}
+
+	m_hashes[ut] = h;
+
+	return h;
+}
+
+uint64_t ProgramDiff::hashType(Cpp::Type &type, uint64_t h)
+{
+	for (Cpp::Type::Modifier mod : type.modifiers)
+		h = hashMix(h, (uint64_t)mod);
+
+	if (type.isFundamentalType)
+		return hashMix(hashMix(h, 1), (uint64_t)type.fundamentalType);
+
+	Cpp::UserType *ut = type.userType;
+
+	// Named types are referred to by name, so a change to one is reported
+	// once instead of for every type that uses it
+	if (!ut->anonymous && ut->type != Cpp::UserType::ARRAY && ut->type != Cpp::UserType::FUNCTION)
+		return hashMix(hashMix(hashMix(h, 2), (uint64_t)ut->type), ut->name);
+
+	return hashMix(hashMix(h, 3), hashUserType(ut));
+}
+
+uint64_t ProgramDiff::hashFunction(Cpp::Function &fun)
+{
+	uint64_t h = hashMix(FNV_OFFSET, fun.name);
+
+	if (fun.typeOwner)
+		h = hashMix(h, fun.typeOwner->name);
+
+	h = hashType(fun.returnType, h);
+
+	for (Cpp::FunctionType::Parameter &p : fun.parameters)
+		h = hashType(p.type, h);
+
+	return h;
+}
+
+int runDiff(const char *oldFilename, const char *newFilename)
+{
+	if (!convertElfFile(oldFilename))
+		return 1;
+
+	std::vector<Cpp::File*> oldFiles = takeConvertedFiles();
+
+	if (!convertElfFile(newFilename))
+		return 1;
+
+	std::vector<Cpp::File*> newFiles = takeConvertedFiles();
+
+	std::cout << "Comparing " << oldFilename << " to " << newFilename << "..." << std::endl << std::endl;
+
+	ProgramDiff diff(oldFiles, newFiles);
+	diff.write(std::cout);
+
+	return 0;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "cpp.h"
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// Compares the user types and functions of two converted programs.
+// Types and functions are matched by name, and compared by a structural hash
+// first so unchanged ones are skipped without looking at their members.
+class ProgramDiff
+{
+public:
+	struct Summary
+	{
+		int typesAdded = 0;
+		int typesRemoved = 0;
+		int typesChanged = 0;
+		int functionsAdded = 0;
+		int functionsRemoved = 0;
+		int functionsChanged = 0;
+	};
+
+	ProgramDiff(std::vector<Cpp::File*> &oldFiles, std::vector<Cpp::File*> &newFiles);
+
+	// Writes the report and returns the summary
+	Summary write(std::ostream &out);
+
+private:
+	// Every distinct definition of a type or function with the same key
+	struct TypeVariants
+	{
+		std::vector<uint64_t> hashes;
+		std::vector<Cpp::UserType*> types;
+	};
+
+	struct FunctionVariants
+	{
+		std::vector<uint64_t> hashes;
+		std::vector<Cpp::Function*> functions;
+	};
+
+	struct Program
+	{
+		std::unordered_map<std::string, TypeVariants> types;
+		std::unordered_map<std::string, FunctionVariants> functions;
+		std::vector<std::string> typeOrder;
+		std::vector<std::string> functionOrder;
+	};
+
+	Program m_old;
+	Program m_new;
+	std::unordered_map<Cpp::UserType*, uint64_t> m_hashes;
+
+	void index(std::vector<Cpp::File*> &files, Program *program);
+	void writeTypeChanges(std::ostream &out, Cpp::UserType *before, Cpp::UserType *after);
+
+	uint64_t hashUserType(Cpp::UserType *ut);
+	uint64_t hashType(Cpp::Type &type, uint64_t h);
+	uint64_t hashFunction(Cpp::Function &fun);
+};
+
+int runDiff(const char *oldFilename, const char *newFilename);
@@ -1,9 +1,16 @@
 #pragma once
 
 #include "elf.h"
+#include "trace.h"
+#include "memstats.h"
+#include "strscan.h"
 
 #include <map>
+#include <atomic>
+#include <vector>
+#include <algorithm>
 #include <iostream>
+#include <functional>
 #include <unordered_map>
 
 #define DW_TAG_padding                0x0000
@@ -113,6 +120,12 @@
 // User attributes
 #define DW_AT_mangled_name         (DW_AT_lo_user|DW_FORM_STRING)
 
+// Attribute masks. Every standard attribute name maps to a bit by its name
+// index (forms of the same attribute share a bit); user attributes share bit 63.
+#define DW_AT_INDEX(at)  (((at) & DW_AT_lo_user) ? 63 : (((at) >> 4) & 0x3f))
+#define DW_AT_BIT(at)    (1ull << DW_AT_INDEX(at))
+#define DW_AT_MASK_ALL   (~0ull)
+
 #define DW_OP_REG     0x01
 #define DW_OP_BASEREG 0x02
 #define DW_OP_ADDR    0x03
@@ -188,6 +201,40 @@
 
 #define SHT_DWARF1 0x70000005
 
+// Character replaced in type names, located while sizing DW_FORM_STRING values
+#define DWARF_SPECIAL_CHAR '@'
+#define DWARF_NO_SPECIAL   0xffffffff
+
+// How the value of each attribute form is laid out. Values are either a fixed
+// number of bytes, prefixed with their length, or null-terminated strings.
+struct DwarfFormDescriptor
+{
+	bool valid;
+	bool isString;
+	Elf32_Half fixedSize;
+	Elf32_Half prefixSize;
+};
+
+static constexpr DwarfFormDescriptor DwarfForms[16] =
+{
+	{ false, false, 0, 0 },                  // 0x0
+	{ true,  false, sizeof(Elf32_Addr), 0 }, // DW_FORM_ADDR
+	{ true,  false, sizeof(Elf32_Off), 0 },  // DW_FORM_REF
+	{ true,  false, 0, sizeof(Elf32_Half) }, // DW_FORM_BLOCK2
+	{ true,  false, 0, sizeof(Elf32_Word) }, // DW_FORM_BLOCK4
+	{ true,  false, sizeof(Elf32_Half), 0 }, // DW_FORM_DATA2
+	{ true,  false, sizeof(Elf32_Word), 0 }, // DW_FORM_DATA4
+	{ true,  false, sizeof(uint64_t), 0 },   // DW_FORM_DATA8
+	{ true,  true,  0, 0 },                  // DW_FORM_STRING
+	{ false, false, 0, 0 },
+	{ false, false, 0, 0 },
+	{ false, false, 0, 0 },
+	{ false, false, 0, 0 },
+	{ false, false, 0, 0 },
+	{ false, false, 0, 0 },
+	{ false, false, 0, 0 }
+};
+
 class Dwarf
 {
 public:
@@ -208,6 +255,7 @@ public:
 		Elf32_Off offset;
 		Elf32_Half name;
 		Elf32_Word size;
+		Elf32_Word firstSpecial; // Index of the first DWARF_SPECIAL_CHAR in a string
 		void *value;
 
 		inline Elf32_Half getForm()
@@ -249,6 +297,16 @@ public:
 		{
 			return (char*)value;
 		}
+
+		inline Elf32_Word getStringLength()
+		{
+			return size - 1;
+		}
+
+		inline bool hasSpecial()
+		{
+			return firstSpecial != DWARF_NO_SPECIAL;
+		}
 	};
 
 	struct Entry
@@ -261,34 +319,97 @@ public:
 		Attribute attributes[32];
 		int numAttributes = 0;
 
+		// DW_AT_BIT of every attribute present, and the index in attributes of the
+		// first attribute at each DW_AT_INDEX whose bit is set. Kept up to date
+		// by indexAttribute.
+		uint64_t attributeMask = 0;
+		uint8_t attributeSlots[64];
+
+		// Set for entries loaded on demand, whose siblings are resolved when they're loaded
+		Entry *sibling = nullptr;
+
 		inline bool isNullEntry()
 		{
 			return length < 8;
 		}
 
+		// Appends an attribute slot, which the caller decodes and then indexes with indexAttribute
+		inline Attribute* addAttribute()
+		{
+			return &attributes[numAttributes++];
+		}
+
+		inline void indexAttribute(Attribute *attr)
+		{
+			uint64_t bit = DW_AT_BIT(attr->name);
+
+			if (!(attributeMask & bit))
+			{
+				attributeSlots[DW_AT_INDEX(attr->name)] = (uint8_t)(attr - attributes);
+				attributeMask |= bit;
+			}
+		}
+
+		inline void clearAttributes()
+		{
+			numAttributes = 0;
+			attributeMask = 0;
+		}
+
+		// Whether an attribute of name's kind is present. Forms of the same
+		// attribute, and user attributes, share a kind.
+		inline bool has(Elf32_Half name)
+		{
+			return (attributeMask & DW_AT_BIT(name)) != 0;
+		}
+
+		// The first attribute called name, or nullptr
+		inline Attribute* get(Elf32_Half name)
+		{
+			if (!has(name))
+				return nullptr;
+
+			int i = attributeSlots[DW_AT_INDEX(name)];
+
+			// Another form or user attribute can come first in the same slot
+			for (; i < numAttributes; i++)
+			{
+				if (attributes[i].name == name)
+					return &attributes[i];
+			}
+
+			return nullptr;
+		}
+
 		inline Entry* getSibling()
 		{
+			if (sibling)
+				return sibling;
+
 			if (index == dwarf->numEntries - 1)
 				return nullptr;
 
-			for (int i = 0; i < numAttributes; i++)
-			{
-				Attribute *attr = &attributes[i];
+			Attribute *attr = get(DW_AT_sibling);
 
-				if (attr->name == DW_AT_sibling)
-				{
-					Elf32_Off offset = attr->getReference();
-					Entry *sibling = dwarf->getEntryFromReference(offset);
+			if (attr)
+			{
+				Elf32_Off offset = attr->getReference();
+				Entry *sibling = dwarf->getEntryFromReference(offset);
 
-					if (sibling)
-						return sibling;
+				if (sibling)
+					return sibling;
 
-					break;
-				}
+				// The sibling is in a compile unit that was skipped
+				if (dwarf->m_skippedRanges.size() > 0)
+					return dwarf->getFirstEntryFrom(offset);
 			}
 
+			if (dwarf->m_parseWaiter)
+				dwarf->waitForEntry(this + 1);
+
 			return this + 1;
 		}
+
 	};
 
 	struct LineEntry
@@ -298,15 +419,62 @@ public:
 		int hexAddressOffset;
 	};
 
-	std::multimap<int, LineEntry> lineEntryMap;
+	typedef std::multimap<int, LineEntry, std::less<int>,
+		CountingAllocator<std::pair<const int, LineEntry>, MEM_DWARF_LINES>> LineEntryMap;
+	typedef std::vector<Entry, CountingAllocator<Entry, MEM_DWARF_ENTRIES>> EntryVector;
+	typedef std::unordered_map<Elf32_Off, Entry*, std::hash<Elf32_Off>, std::equal_to<Elf32_Off>,
+		CountingAllocator<std::pair<const Elf32_Off, Entry*>, MEM_DWARF_REFS>> EntryRefMap;
+
+	LineEntryMap lineEntryMap;
 
-	Entry entries[500000]; // should be enough right? :p
+	EntryVector entries;
 	int numEntries = 0;
 
-	Dwarf(ElfFile *elf)
+	// The tag of every parsed entry, 0 for null entries, packed so it can be
+	// scanned without touching the entries, see findTag
+	std::vector<Elf32_Half, CountingAllocator<Elf32_Half, MEM_DWARF_ENTRIES>> tags;
+
+	// Kinds of entries directly inside a compile unit that are indexed while parsing
+	enum TagIndex
+	{
+		INDEX_STRUCTURES, // Classes and structures
+		INDEX_UNIONS,
+		INDEX_ENUMS,
+		INDEX_ARRAYS,
+		INDEX_SUBROUTINE_TYPES,
+		INDEX_SUBROUTINES, // Global, local and inlined subroutines
+		INDEX_VARIABLES, // Global and local variables
+		INDEX_COUNT
+	};
+
+	typedef std::vector<int, CountingAllocator<int, MEM_DWARF_ENTRIES>> IndexVector;
+
+	// Indexes into entries, in section order
+	struct IndexRange
+	{
+		const int *first;
+		const int *last;
+
+		inline const int* begin() const { return first; }
+		inline const int* end() const { return last; }
+		inline size_t size() const { return last - first; }
+	};
+
+	// Decides from its name whether a compile unit is parsed
+	typedef std::function<bool(const char *name, size_t length)> CompileUnitFilter;
+
+	// Attributes outside attributeMask are skipped while parsing instead of being
+	// stored in their entry. DW_AT_sibling is always kept.
+	// Compile units rejected by filter are stepped over using their sibling
+	// offset. Their entries are only read if something refers to them, see loadEntry.
+	// If parse is false, only the line numbers and where each entry is are read
+	// up front, and the entries are parsed a compile unit at a time with
+	// parseCompileUnit.
+	Dwarf(ElfFile *elf, uint64_t attributeMask = DW_AT_MASK_ALL, const CompileUnitFilter &filter = nullptr, bool parse = true)
 	{
 		m_error = ERR_NONE;
 		m_elf = elf;
+		m_attributeMask = attributeMask | DW_AT_BIT(DW_AT_sibling);
 
 		m_section = m_elf->getSectionHeader(".debug");
 
@@ -319,12 +487,80 @@ public:
 		m_sectionData = m_elf->getSectionData(m_section);
 		m_sectionSize = m_section->sh_size;
 
-		Elf32_Off offset = 0;
+		// Entries are counted up front so the array is allocated once and
+		// pointers to entries stay valid
+		int count = countEntries(filter);
+
+		if (m_error)
+			return;
+
+		entries.resize(count);
+		tags.resize(count);
+		m_entryRefMap.reserve(count);
+		numEntries = count;
+
+		layoutEntries();
+		readLineEntries();
+
+		if (!parse)
+			return;
 
-		m_entryRefMap.reserve(500000);
+		TraceSpan parseSpan("Parse DWARF");
+		parseSpan.arg("entries", count);
+		parseSpan.arg("bytes", m_sectionSize);
 
-		while (offset < m_sectionSize && !m_error)
-			offset = readEntry(offset);
+		while (parseCompileUnit() >= 0);
+	}
+
+	// Parses the entries of the next compile unit, and of anything before it
+	// that isn't in one. Returns the index of the compile unit's entry, or -1
+	// once every entry is parsed or parsing failed.
+	//
+	// Only the entries that aren't parsed yet change, so another thread can
+	// use the compile units this has returned while it parses the next one.
+	// That thread has to set a ParseWaiter, which getEntryFromReference and
+	// getSibling call before they return an entry that isn't parsed yet.
+	int parseCompileUnit()
+	{
+		int first = m_parsedEntries.load(std::memory_order_relaxed);
+
+		if (first >= numEntries || m_error)
+			return -1;
+
+		int unit = findTag(DW_TAG_compile_unit, first);
+		int last = (unit < numEntries) ? findTag(DW_TAG_compile_unit, unit + 1) : numEntries;
+
+		TraceSpan span("Parse compile unit");
+		span.arg("entries", last - first);
+		span.arg("bytes", entries[last - 1].offset + entries[last - 1].length - entries[first].offset);
+
+		for (int i = first; i < last && !m_error; i++)
+		{
+			readEntry(entries[i].offset, &entries[i], i);
+
+			if (!m_error)
+				indexEntry(i, &m_nextChild, &m_unitEnd);
+		}
+
+		m_parsedEntries.store(last, std::memory_order_release);
+
+		if (m_error || unit == numEntries)
+			return -1;
+
+		CompileUnitIndex &cu = m_compileUnits.back();
+
+		for (int i = 0; i < INDEX_COUNT; i++)
+			cu.last[i] = (uint32_t)m_indexes[i].size();
+
+		m_parsedUnits.store(m_compileUnits.size(), std::memory_order_release);
+
+		return unit;
+	}
+
+	// Reads the line numbers of every function from .line
+	void readLineEntries()
+	{
+		TraceSpan lineSpan("Parse line numbers");
 
 		// Read debug line data.
 		Elf32_Shdr* m_lineHeader;
@@ -333,23 +569,33 @@ public:
 		{
 			char* m_lineSectionDataStart;
 			char* m_lineSectionData;
+			char* m_lineSectionDataEnd;
 			m_lineSectionDataStart = m_elf->getSectionData(m_lineHeader);
 			m_lineSectionData = m_lineSectionDataStart;
+			m_lineSectionDataEnd = m_lineSectionDataStart + m_lineHeader->sh_size;
 
-			while (m_lineHeader->sh_size > (int)(m_lineSectionData - m_lineSectionDataStart)) {
-				int byteSize;
+			const size_t chunkHeaderSize = 2 * sizeof(int);
+			const size_t lineEntrySize = 2 * sizeof(int) + sizeof(short);
+
+			while ((size_t)(m_lineSectionDataEnd - m_lineSectionData) >= chunkHeaderSize) {
+				size_t byteSize;
 				int funcPtr;
 				char* m_lineSectionDataChunkEnd;
 				m_lineSectionDataChunkEnd = m_lineSectionData;
 
-				byteSize = read<int>(m_lineSectionData);
+				byteSize = read<Elf32_Word>(m_lineSectionData);
 				m_lineSectionData += sizeof(int);
+
+				// A chunk can't extend past the section or be smaller than its header
+				if (byteSize < chunkHeaderSize || byteSize > (size_t)(m_lineSectionDataEnd - m_lineSectionDataChunkEnd))
+					break;
+
 				m_lineSectionDataChunkEnd += byteSize;
 
 				funcPtr = read<int>(m_lineSectionData);
 				m_lineSectionData += sizeof(int);
 
-				while (m_lineSectionDataChunkEnd > m_lineSectionData) {
+				while ((size_t)(m_lineSectionDataChunkEnd - m_lineSectionData) >= lineEntrySize) {
 					LineEntry entry;
 
 					entry.lineNumber = read<int>(m_lineSectionData);
@@ -362,21 +608,224 @@ public:
 					if (entry.lineNumber == 0)
 						break; // End.
 				}
+
+				m_lineSectionData = m_lineSectionDataChunkEnd;
+			}
+		}
+	}
+
+	int countEntries(const CompileUnitFilter &filter)
+	{
+		int count = 0;
+		Elf32_Off offset = 0;
+
+		while (offset < m_sectionSize)
+		{
+			// Too short for another entry, so it's padding
+			if (m_sectionSize - offset < sizeof(Elf32_Word))
+			{
+				m_sectionSize = offset;
+				break;
+			}
+
+			Elf32_Word length = read<Elf32_Word>(m_sectionData + offset);
+
+			if (length < sizeof(Elf32_Word) || length > m_sectionSize - offset)
+			{
+				m_error = ERR_INVALID_ENTRY;
+				return 0;
+			}
+
+			Elf32_Off end;
+
+			if (filter && isRejectedCompileUnit(offset, filter, &end))
+			{
+				m_skippedRanges.push_back(std::make_pair(offset, end));
+				offset = end;
+				continue;
 			}
+
+			offset += length;
+			count++;
 		}
+
+		return count;
 	}
 
-	Elf32_Off readEntry(Elf32_Off offset, Entry **outEntry = nullptr)
+	// Records where each entry that will be parsed is, its length and its
+	// tag, and makes room in the indexes for every entry that could go in them
+	void layoutEntries()
 	{
-		int index = numEntries++;
+		Elf32_Off offset = 0;
+		size_t nextSkipped = 0;
+		size_t units = 0;
+		size_t counts[INDEX_COUNT] = {};
+
+		for (int i = 0; i < numEntries; i++)
+		{
+			while (nextSkipped < m_skippedRanges.size() && offset == m_skippedRanges[nextSkipped].first)
+				offset = m_skippedRanges[nextSkipped++].second;
+
+			Entry &entry = entries[i];
+			entry.dwarf = this;
+			entry.index = i;
+			entry.offset = offset;
+			entry.length = read<Elf32_Word>(m_sectionData + offset);
+			entry.tag = entry.isNullEntry() ? 0 : read<Elf32_Half>(m_sectionData + offset + sizeof(Elf32_Word));
+
+			tags[i] = entry.tag;
+			m_entryRefMap.emplace(offset, &entry);
+
+			int kind = getTagIndex(entry.tag);
+
+			if (entry.tag == DW_TAG_compile_unit)
+				units++;
+			else if (kind >= 0)
+				counts[kind]++;
+
+			offset += entry.length;
+		}
+
+		// Never reallocated while parsing, so other threads can read them
+		m_compileUnits.reserve(units);
+
+		for (int i = 0; i < INDEX_COUNT; i++)
+			m_indexes[i].reserve(counts[i]);
+	}
+
+	// Whether the entry at offset is a compile unit that filter rejects and
+	// that can be stepped over. outEnd is set to its sibling's offset.
+	bool isRejectedCompileUnit(Elf32_Off offset, const CompileUnitFilter &filter, Elf32_Off *outEnd)
+	{
+		Entry header;
+
+		if (!peekEntry(offset, &header) || header.tag != DW_TAG_compile_unit)
+			return false;
+
+		Attribute *name = header.get(DW_AT_name);
+		Attribute *sibling = header.get(DW_AT_sibling);
+
+		if (!name || !sibling || filter(name->getString(), name->getStringLength()))
+			return false;
+
+		*outEnd = sibling->getReference();
 
-		Entry *entry = &entries[index];
+		return *outEnd > offset + header.length && *outEnd <= m_sectionSize;
+	}
+
+	// Reads the tag of the entry at offset and the attributes whose DW_AT_BIT
+	// is in attributes, without adding it to the parsed entries
+	bool peekEntry(Elf32_Off offset, Entry *entry, uint64_t attributes = DW_AT_BIT(DW_AT_name) | DW_AT_BIT(DW_AT_sibling))
+	{
 		entry->dwarf = this;
-		entry->index = index;
+		entry->index = -1;
 		entry->offset = offset;
 		entry->length = read<Elf32_Word>(m_sectionData + offset);
+		entry->tag = 0;
+		entry->clearAttributes();
+
+		if (entry->isNullEntry())
+			return true;
+
+		Elf32_Off end = offset + entry->length;
+		offset += sizeof(Elf32_Word);
+
+		entry->tag = read<Elf32_Half>(m_sectionData + offset);
+		offset += sizeof(Elf32_Half);
+
+		while (offset < end && !m_error)
+		{
+			if (!fitsInEntry(entry, offset, sizeof(Elf32_Half)))
+				return false;
+
+			Elf32_Half name = read<Elf32_Half>(m_sectionData + offset);
+
+			if ((attributes & DW_AT_BIT(name)) && entry->numAttributes < (int)(sizeof(entry->attributes) / sizeof(Attribute)))
+			{
+				Attribute *attribute = entry->addAttribute();
+				offset = decodeAttribute(offset, entry, attribute);
+				entry->indexAttribute(attribute);
+			}
+			else
+				offset = skipAttribute(offset, entry);
+		}
+
+		return !m_error && offset == end;
+	}
+
+	// Reads the entry at ref and its children, for a reference into a compile
+	// unit that was skipped. Returns nullptr if ref isn't the start of an entry
+	// in one. The entries are kept in a block of their own, which ends with a
+	// null entry that their siblings resolve to when they point past it.
+	Entry* loadEntry(Elf32_Off ref)
+	{
+		Entry *existing = getEntryFromReference(ref);
+
+		if (existing)
+			return existing;
+
+		const std::pair<Elf32_Off, Elf32_Off> *range = findSkippedRange(ref);
 
-		m_entryRefMap[offset] = entry;
+		if (!range || range->second - ref < sizeof(Elf32_Word))
+			return nullptr;
+
+		Entry root;
+
+		if (!peekEntry(ref, &root) || root.length > range->second - ref)
+			return nullptr;
+
+		Elf32_Off end = ref + root.length;
+		Attribute *sibling = root.get(DW_AT_sibling);
+
+		if (sibling && sibling->getReference() > end && sibling->getReference() <= range->second)
+			end = sibling->getReference();
+
+		int count = 0;
+
+		for (Elf32_Off offset = ref; offset < end; count++)
+		{
+			Elf32_Word length = read<Elf32_Word>(m_sectionData + offset);
+
+			if (length < sizeof(Elf32_Word) || length > end - offset)
+				return nullptr;
+
+			offset += length;
+		}
+
+		m_loadedBlocks.emplace_back(count + 1);
+		EntryVector &block = m_loadedBlocks.back();
+
+		Elf32_Off offset = ref;
+
+		for (int i = 0; i < count && !m_error; i++)
+		{
+			// An entry loaded on demand might already be inside an earlier block
+			m_entryRefMap.emplace(offset, &block[i]);
+			offset = readEntry(offset, &block[i], -1);
+		}
+
+		if (m_error)
+			return nullptr;
+
+		Entry *terminator = &block[count];
+		terminator->dwarf = this;
+		terminator->index = -1;
+		terminator->offset = end;
+		terminator->length = 0;
+		terminator->tag = 0;
+
+		for (int i = 0; i < count; i++)
+			block[i].sibling = findSiblingInBlock(block, count, &block[i]);
+
+		return &block[0];
+	}
+
+	Elf32_Off readEntry(Elf32_Off offset, Entry *entry, int index)
+	{
+		entry->dwarf = this;
+		entry->index = index;
+		entry->offset = offset;
+		entry->length = read<Elf32_Word>(m_sectionData + offset);
 
 		Elf32_Word end = offset + entry->length;
 
@@ -384,6 +833,12 @@ public:
 			offset = end;
 		else
 		{
+			if (entry->length < sizeof(Elf32_Word) + sizeof(Elf32_Half))
+			{
+				m_error = ERR_INVALID_ENTRY;
+				return 0;
+			}
+
 			offset += sizeof(Elf32_Word);
 
 			entry->tag = read<Elf32_Half>(m_sectionData + offset);
@@ -399,75 +854,227 @@ public:
 			}
 		}
 
-		if (outEntry)
-			*outEntry = entry;
-
 		return offset;
 	}
 
 	Elf32_Off readAttribute(Elf32_Off offset, Entry *entry, Attribute **outAttr = nullptr)
 	{
-		Attribute *attribute = &entry->attributes[entry->numAttributes++];
+		if (!fitsInEntry(entry, offset, sizeof(Elf32_Half)))
+		{
+			m_error = ERR_INVALID_ATTRIBUTE;
+			return 0;
+		}
+
+		Elf32_Half name = read<Elf32_Half>(m_sectionData + offset);
 
+		// Skip attributes nobody asked for without materialising them
+		if (!(m_attributeMask & DW_AT_BIT(name)))
+			return skipAttribute(offset, entry);
+
+		if (entry->numAttributes == sizeof(entry->attributes) / sizeof(Attribute))
+		{
+			m_error = ERR_INVALID_ENTRY;
+			return 0;
+		}
+
+		Attribute *attribute = entry->addAttribute();
+
+		offset = decodeAttribute(offset, entry, attribute);
+		entry->indexAttribute(attribute);
+
+		if (outAttr)
+			*outAttr = attribute;
+
+		return offset;
+	}
+
+	// Decodes the attribute at offset into attribute without adding it to an entry.
+	Elf32_Off decodeAttribute(Elf32_Off offset, Entry *entry, Attribute *attribute)
+	{
 		attribute->entry = entry;
 		attribute->offset = offset;
+		attribute->firstSpecial = DWARF_NO_SPECIAL;
 		attribute->name = read<Elf32_Half>(m_sectionData + offset);
 		offset += sizeof(Elf32_Half);
 
-		Elf32_Half form = attribute->getForm();
+		const DwarfFormDescriptor &form = DwarfForms[attribute->getForm()];
+
+		if (!form.valid || !fitsInEntry(entry, offset, form.prefixSize))
+		{
+			m_error = ERR_INVALID_ATTRIBUTE;
+			return 0;
+		}
 
-		switch (form)
+		if (form.isString)
+		{
+			StrScan::Result scan = StrScan::scan(m_sectionData + offset, DWARF_SPECIAL_CHAR);
+			attribute->size = scan.length + 1;
+
+			if (scan.firstSpecial != StrScan::npos)
+				attribute->firstSpecial = scan.firstSpecial;
+		}
+		else if (form.prefixSize == sizeof(Elf32_Half))
 		{
-		case DW_FORM_ADDR:
-			attribute->size = sizeof(Elf32_Addr);
-			break;
-		case DW_FORM_REF:
-			attribute->size = sizeof(Elf32_Off);
-			break;
-		case DW_FORM_BLOCK2:
 			attribute->size = read<Elf32_Half>(m_sectionData + offset);
 			offset += sizeof(Elf32_Half);
-			break;
-		case DW_FORM_BLOCK4:
+		}
+		else if (form.prefixSize == sizeof(Elf32_Word))
+		{
 			attribute->size = read<Elf32_Word>(m_sectionData + offset);
 			offset += sizeof(Elf32_Word);
-			break;
-		case DW_FORM_DATA2:
-			attribute->size = sizeof(Elf32_Half);
-			break;
-		case DW_FORM_DATA4:
-			attribute->size = sizeof(Elf32_Word);
-			break;
-		case DW_FORM_DATA8:
-			attribute->size = sizeof(uint64_t);
-			break;
-		case DW_FORM_STRING:
-			attribute->size = strlen(m_sectionData + offset) + 1;
-			break;
-		default:
-			m_error = ERR_INVALID_ATTRIBUTE;
-			return 0;
 		}
+		else
+			attribute->size = form.fixedSize;
 
 		attribute->value = m_sectionData + offset;
-		
-		if (outAttr)
-			*outAttr = attribute;
 
 		return offset + attribute->size;
 	}
 
+	// Returns the offset just past the attribute at offset.
+	Elf32_Off skipAttribute(Elf32_Off offset, Entry *entry)
+	{
+		Elf32_Half name = read<Elf32_Half>(m_sectionData + offset);
+		offset += sizeof(Elf32_Half);
+
+		const DwarfFormDescriptor &form = DwarfForms[name & 0xf];
+
+		if (!form.valid || !fitsInEntry(entry, offset, form.prefixSize))
+		{
+			m_error = ERR_INVALID_ATTRIBUTE;
+			return 0;
+		}
+
+		if (form.fixedSize)
+			return offset + form.fixedSize;
+
+		if (form.isString)
+			return offset + StrScan::length(m_sectionData + offset) + 1;
+
+		if (form.prefixSize == sizeof(Elf32_Half))
+			return offset + sizeof(Elf32_Half) + read<Elf32_Half>(m_sectionData + offset);
+
+		return offset + sizeof(Elf32_Word) + read<Elf32_Word>(m_sectionData + offset);
+	}
+
 	inline Error getError()
 	{
 		return m_error;
 	}
 
+	// Whether size bytes at offset are inside entry
+	inline bool fitsInEntry(Entry *entry, Elf32_Off offset, Elf32_Word size) const
+	{
+		Elf32_Off end = entry->offset + entry->length;
+
+		return offset <= end && size <= end - offset;
+	}
+
+	// Drops the parsed entries once they've been converted. Line data is kept.
+	void freeEntries()
+	{
+		EntryVector().swap(entries);
+		EntryRefMap().swap(m_entryRefMap);
+		std::vector<EntryVector>().swap(m_loadedBlocks);
+		decltype(tags)().swap(tags);
+
+		for (int i = 0; i < INDEX_COUNT; i++)
+			IndexVector().swap(m_indexes[i]);
+
+		std::vector<CompileUnitIndex>().swap(m_compileUnits);
+		m_parsedUnits = 0;
+		numEntries = 0;
+	}
+
+	// The entries of a kind directly inside any compile unit, once every
+	// entry is parsed
+	inline IndexRange getIndexed(TagIndex kind) const
+	{
+		const IndexVector &index = m_indexes[kind];
+
+		return { index.data(), index.data() + index.size() };
+	}
+
+	// The entries of a kind directly inside compileUnit, which must be a parsed entry
+	IndexRange getIndexed(TagIndex kind, const Entry *compileUnit) const
+	{
+		const CompileUnitIndex *units = m_compileUnits.data();
+		const CompileUnitIndex *end = units + m_parsedUnits.load(std::memory_order_acquire);
+
+		auto it = std::lower_bound(units, end, compileUnit->index,
+			[](const CompileUnitIndex &cu, int index) { return cu.entry < index; });
+
+		const IndexVector &index = m_indexes[kind];
+
+		if (it == end || it->entry != compileUnit->index)
+			return { index.data(), index.data() };
+
+		return { index.data() + it->first[kind], index.data() + it->last[kind] };
+	}
+
+	// The index of the first parsed entry from index from on with tag, or
+	// numEntries if there is none
+	int findTag(Elf32_Half tag, int from) const
+	{
+		const Elf32_Half *data = tags.data();
+		int i = from;
+
+#if defined(STRSCAN_AVX2) || defined(STRSCAN_SSE2)
+		const __m128i wanted = _mm_set1_epi16((short)tag);
+
+		for (; i + 8 <= numEntries; i += 8)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+			uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi16(v, wanted));
+
+			// Two mask bits per tag
+			if (mask)
+				return i + StrScan::countTrailingZeros(mask) / 2;
+		}
+#endif
+
+		for (; i < numEntries; i++)
+		{
+			if (data[i] == tag)
+				return i;
+		}
+
+		return numEntries;
+	}
+
 	inline Entry* getEntryFromReference(Elf32_Off ref)
 	{
-		if (m_entryRefMap.count(ref) == 0)
+		auto it = m_entryRefMap.find(ref);
+
+		if (it == m_entryRefMap.end())
 			return nullptr;
 
-		return m_entryRefMap[ref];
+		if (m_parseWaiter)
+			waitForEntry(it->second);
+
+		return it->second;
+	}
+
+	// Whether parseCompileUnit is past the entry at index. Once it is, the
+	// entry can be read on any thread.
+	inline bool isParsed(int index) const
+	{
+		return index < m_parsedEntries.load(std::memory_order_acquire);
+	}
+
+	// Called with the index of an entry that isn't parsed yet, by the thread
+	// about to use it. Returns once isParsed is true for it, or parsing stopped.
+	typedef std::function<void(int index)> ParseWaiter;
+
+	// Set before another thread starts calling parseCompileUnit
+	void setParseWaiter(const ParseWaiter &waiter)
+	{
+		m_parseWaiter = waiter;
+	}
+
+	inline Elf32_Word getSectionSize()
+	{
+		return m_sectionSize;
 	}
 
 	inline Elf32_Off pointerToOffset(char *ptr)
@@ -487,12 +1094,163 @@ public:
 	}
 
 private:
-	Error m_error;
+	// Atomic since entries loaded on demand can fail on another thread while parseCompileUnit runs
+	std::atomic<Error> m_error;
 
 	ElfFile *m_elf;
 	Elf32_Shdr *m_section;
 	char *m_sectionData;
 	Elf32_Word m_sectionSize;
+	uint64_t m_attributeMask;
+
+	EntryRefMap m_entryRefMap;
+
+	// Compile units skipped by the filter, as [start, end) offsets in section order
+	std::vector<std::pair<Elf32_Off, Elf32_Off>> m_skippedRanges;
+	std::vector<EntryVector> m_loadedBlocks;
+
+	// Where each parsed compile unit's entries are in the indexes
+	struct CompileUnitIndex
+	{
+		int entry;
+		uint32_t first[INDEX_COUNT];
+		uint32_t last[INDEX_COUNT];
+	};
+
+	IndexVector m_indexes[INDEX_COUNT];
+	std::vector<CompileUnitIndex> m_compileUnits;
+
+	// Progress of parseCompileUnit. Compile units before m_parsedUnits are
+	// complete in m_compileUnits and the indexes.
+	std::atomic<int> m_parsedEntries{0};
+	std::atomic<size_t> m_parsedUnits{0};
+	ParseWaiter m_parseWaiter;
+	Elf32_Off m_nextChild = 0; // The next entry directly inside the current compile unit
+	Elf32_Off m_unitEnd = 0;
+
+	static int getTagIndex(Elf32_Half tag)
+	{
+		switch (tag)
+		{
+		case DW_TAG_class_type:
+		case DW_TAG_structure_type: return INDEX_STRUCTURES;
+		case DW_TAG_union_type: return INDEX_UNIONS;
+		case DW_TAG_enumeration_type: return INDEX_ENUMS;
+		case DW_TAG_array_type: return INDEX_ARRAYS;
+		case DW_TAG_subroutine_type: return INDEX_SUBROUTINE_TYPES;
+		case DW_TAG_global_subroutine:
+		case DW_TAG_subroutine:
+		case DW_TAG_inlined_subroutine: return INDEX_SUBROUTINES;
+		case DW_TAG_global_variable:
+		case DW_TAG_local_variable: return INDEX_VARIABLES;
+		}
+
+		return -1;
+	}
+
+	// Indexes a just parsed entry if it's directly inside a compile unit,
+	// following the same sibling chain as getSibling
+	void indexEntry(int index, Elf32_Off *nextChild, Elf32_Off *unitEnd)
+	{
+		Entry &entry = entries[index];
+		Elf32_Off end = entry.offset + entry.length;
+
+		if (entry.isNullEntry())
+		{
+			if (entry.offset == *nextChild)
+				*nextChild = end;
 
-	std::unordered_map<Elf32_Off, Entry*> m_entryRefMap;
+			return;
+		}
+
+		Attribute *sibling = entry.get(DW_AT_sibling);
+
+		if (entry.tag == DW_TAG_compile_unit)
+		{
+			CompileUnitIndex cu;
+			cu.entry = index;
+
+			for (int i = 0; i < INDEX_COUNT; i++)
+				cu.first[i] = cu.last[i] = (uint32_t)m_indexes[i].size();
+
+			m_compileUnits.push_back(cu);
+
+			*nextChild = end;
+			*unitEnd = sibling ? sibling->getReference() : end;
+			return;
+		}
+
+		if (entry.offset != *nextChild || entry.offset >= *unitEnd)
+			return;
+
+		*nextChild = (sibling && sibling->getReference() > entry.offset) ? sibling->getReference() : end;
+
+		int kind = getTagIndex(entry.tag);
+
+		if (kind >= 0)
+			m_indexes[kind].push_back(index);
+	}
+
+	const std::pair<Elf32_Off, Elf32_Off>* findSkippedRange(Elf32_Off offset) const
+	{
+		auto it = std::upper_bound(m_skippedRanges.begin(), m_skippedRanges.end(), offset,
+			[](Elf32_Off o, const std::pair<Elf32_Off, Elf32_Off> &range) { return o < range.first; });
+
+		if (it == m_skippedRanges.begin() || offset >= (it - 1)->second)
+			return nullptr;
+
+		return &*(it - 1);
+	}
+
+	// Waits for an entry that's being parsed on another thread. A compile
+	// unit's sibling is the next one, so converting a compile unit waits for
+	// the next to be parsed, which costs at most one compile unit of overlap.
+	void waitForEntry(Entry *entry)
+	{
+		// Entries loaded on demand are in blocks of their own
+		uintptr_t index = ((uintptr_t)entry - (uintptr_t)entries.data()) / sizeof(Entry);
+
+		if (index < (uintptr_t)numEntries && !isParsed((int)index))
+			m_parseWaiter((int)index);
+	}
+
+	// The first parsed entry at or after offset, or the end of the entries
+	Entry* getFirstEntryFrom(Elf32_Off offset)
+	{
+		const std::pair<Elf32_Off, Elf32_Off> *range;
+
+		while ((range = findSkippedRange(offset)) && range->second > offset)
+			offset = range->second;
+
+		// Found without looking at the entries, which may still be being parsed
+		if (Entry *entry = getEntryFromReference(offset))
+			return entry;
+
+		// The search below reads the offsets of every entry
+		if (m_parseWaiter && !isParsed(numEntries - 1))
+			m_parseWaiter(numEntries - 1);
+
+		auto it = std::lower_bound(entries.begin(), entries.begin() + numEntries, offset,
+			[](const Entry &e, Elf32_Off o) { return e.offset < o; });
+
+		return entries.data() + (it - entries.begin());
+	}
+
+	// The sibling of an entry in a block loaded on demand, or the block's terminator
+	Entry* findSiblingInBlock(EntryVector &block, int count, Entry *entry)
+	{
+		Elf32_Off offset = entry->offset + entry->length;
+		Attribute *sibling = entry->get(DW_AT_sibling);
+
+		if (sibling)
+			offset = sibling->getReference();
+
+		auto it = std::lower_bound(block.begin(), block.begin() + count, offset,
+			[](const Entry &e, Elf32_Off o) { return e.offset < o; });
+
+		if (it != block.begin() + count && it->offset == offset && offset > entry->offset)
+			return &*it;
+
+		return &block[count];
+	}
 };
\ No newline at end of file
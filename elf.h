@@ -8,7 +8,23 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <algorithm>
 #include <cstring>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Files larger than this are mapped a section at a time instead of being loaded whole
+#define ELF_WINDOWED_THRESHOLD (1ull << 30)
+
+// Extra zeroed bytes after sections read into memory, so aligned vector loads
+// at the end of a section stay inside the buffer
+#define ELF_SECTION_PADDING 32
 
 typedef uint32_t Elf32_Addr;
 typedef uint16_t Elf32_Half;
@@ -50,6 +66,8 @@ typedef uint32_t Elf32_Word;
 #define EM_88K   5
 #define EM_860   7
 #define EM_MIPS  8
+#define EM_PPC   20
+#define EM_ARM   40
 
 #define EV_NONE    0
 #define EV_CURRENT 1
@@ -62,6 +80,14 @@ typedef uint32_t Elf32_Word;
 #define SHN_COMMON    0xfff2
 #define SHN_HIRESERVE 0xffff
 
+#define SHT_NULL     0
+#define SHT_PROGBITS 1
+#define SHT_SYMTAB   2
+#define SHT_STRTAB   3
+#define SHT_RELA     4
+#define SHT_NOBITS   8
+#define SHT_REL      9
+
 #define swap4(x) (((x >> 24) & 0xff) | ((x << 8) & 0xff0000) |\
 	((x >> 8) & 0xff00) | ((x << 24) & 0xff000000))
 #define swap2(x) (((x << 8) & 0xff00) | ((x >> 8) & 0x00ff))
@@ -84,6 +110,47 @@ struct Elf32_Ehdr
 	Elf32_Half    e_shstrndx;
 };
 
+struct Elf32_Sym
+{
+	Elf32_Word    st_name;
+	Elf32_Addr    st_value;
+	Elf32_Word    st_size;
+	unsigned char st_info;
+	unsigned char st_other;
+	Elf32_Half    st_shndx;
+};
+
+#define ELF32_ST_BIND(i) ((i) >> 4)
+#define ELF32_ST_TYPE(i) ((i) & 0xf)
+
+#define STB_LOCAL  0
+#define STB_GLOBAL 1
+#define STB_WEAK   2
+
+#define STT_NOTYPE  0
+#define STT_OBJECT  1
+#define STT_FUNC    2
+#define STT_SECTION 3
+#define STT_FILE    4
+
+#define SHN_UNDEF 0
+
+struct Elf32_Rel
+{
+	Elf32_Addr r_offset;
+	Elf32_Word r_info;
+};
+
+struct Elf32_Rela
+{
+	Elf32_Addr  r_offset;
+	Elf32_Word  r_info;
+	Elf32_Sword r_addend;
+};
+
+#define ELF32_R_SYM(i)  ((i) >> 8)
+#define ELF32_R_TYPE(i) ((unsigned char)(i))
+
 struct Elf32_Shdr
 {
 	Elf32_Word sh_name;
@@ -107,39 +174,86 @@ public:
 		ERR_FILE_NOT_OPEN,
 		ERR_FILE_EMPTY,
 		ERR_FILE_READ,
-		ERR_INVALID_HEADER
+		ERR_INVALID_HEADER,
+		ERR_INVALID_SECTION
 	};
 
-	ElfFile(const char *filename)
+	enum LoadMode
+	{
+		// Windowed for files above ELF_WINDOWED_THRESHOLD, otherwise full
+		LOAD_AUTO,
+		// The whole file is read into memory
+		LOAD_FULL,
+		// Only the headers are read up front. Sections are mapped (or read, where
+		// mapping isn't available) the first time their data is asked for.
+		LOAD_WINDOWED
+	};
+
+	// The mode used by files opened without one
+	static LoadMode& defaultLoadMode()
+	{
+		static LoadMode mode = LOAD_AUTO;
+		return mode;
+	}
+
+	ElfFile(const char *filename, LoadMode mode = defaultLoadMode())
 	{
 		m_error = ERR_NONE;
+		m_file = nullptr;
+		m_size = 0;
+		m_ownsFile = true;
+		m_handle = nullptr;
 
-		loadFile(filename);
-		initEndian();
+		loadFile(filename, mode);
 
 		if (m_error)
 			return;
 
-		Elf32_Ehdr *ehdr = getElfHeader();
+		init();
+	}
 
-		if (ehdr->e_ident[EI_MAG0] != 0x7f ||
-			ehdr->e_ident[EI_MAG1] != 'E' ||
-			ehdr->e_ident[EI_MAG2] != 'L' ||
-			ehdr->e_ident[EI_MAG3] != 'F' ||
-			ehdr->e_ident[EI_CLASS] != ELFCLASS32 ||
-			ehdr->e_ident[EI_DATA] == ELFDATANONE ||
-			ehdr->e_ident[EI_VERSION] == EV_NONE ||
-			read<Elf32_Half>(&ehdr->e_ehsize) != sizeof(Elf32_Ehdr) ||
-			read<Elf32_Half>(&ehdr->e_shentsize) != sizeof(Elf32_Shdr) ||
-			read<Elf32_Word>(&ehdr->e_version) == EV_NONE)
+	// Wraps an ELF image that's already in memory, such as an archive member.
+	// The data isn't copied, so it must outlive the ElfFile.
+	ElfFile(char *data, size_t size)
+	{
+		m_error = ERR_NONE;
+		m_file = data;
+		m_size = size;
+		m_ownsFile = false;
+		m_handle = nullptr;
+
+		init();
+	}
+
+	~ElfFile()
+	{
+		if (m_ownsFile)
+			delete[] m_file;
+
+		for (View &view : m_views)
 		{
-			m_error = ERR_INVALID_HEADER;
+#ifndef _WIN32
+			if (view.mapping)
+			{
+				munmap(view.mapping, view.mappingSize);
+				continue;
+			}
+#endif
+			delete[] view.buffer;
 		}
+
+		if (m_handle)
+			fclose(m_handle);
 	}
 
 	inline Elf32_Ehdr* getElfHeader() const
 	{
-		return (Elf32_Ehdr*)m_file;
+		return m_file ? (Elf32_Ehdr*)m_file : (Elf32_Ehdr*)m_header;
+	}
+
+	inline bool isWindowed() const
+	{
+		return m_handle != nullptr;
 	}
 
 	inline unsigned char getClass() const
@@ -152,30 +266,61 @@ public:
 		return getElfHeader()->e_ident[EI_DATA];
 	}
 
-	inline Elf32_Shdr* getSectionHeader(Elf32_Half index) const
+	inline Elf32_Half getType()
 	{
-		return (Elf32_Shdr*)(m_file + getElfHeader()->e_shoff) + index;
+		return read<Elf32_Half>(&getElfHeader()->e_type);
 	}
 
-	inline char* getSectionName(Elf32_Shdr *shdr) const
+	inline Elf32_Half getMachine()
 	{
-		return m_file + getSectionHeader(getElfHeader()->e_shstrndx)->sh_offset + shdr->sh_name;
+		return read<Elf32_Half>(&getElfHeader()->e_machine);
 	}
 
-	inline char* getSectionData(Elf32_Shdr *shdr) const
+	inline bool isRelocatable()
 	{
-		return m_file + shdr->sh_offset;
+		return getType() == ET_REL;
 	}
 
-	inline Elf32_Shdr* getSectionHeader(const char *name) const
+	// Section headers are copied out of the file and converted to host byte
+	// order when the file is loaded, so their fields can be used directly.
+	inline Elf32_Shdr* getSectionHeader(Elf32_Half index)
 	{
-		for (int i = 0; i < getElfHeader()->e_shnum; i++)
-		{
-			if (strcmp(getSectionName(getSectionHeader(i)), name) == 0)
-				return getSectionHeader(i);
-		}
+		return &m_sections[index];
+	}
+
+	inline Elf32_Half getSectionCount() const
+	{
+		return (Elf32_Half)m_sections.size();
+	}
+
+	inline char* getSectionName(Elf32_Shdr *shdr)
+	{
+		return getSectionData(m_sectionNames) + shdr->sh_name;
+	}
+
+	// Section bounds are checked against the file when it's loaded, so the
+	// returned data always has sh_size bytes.
+	inline char* getSectionData(Elf32_Shdr *shdr)
+	{
+		if (m_file)
+			return m_file + shdr->sh_offset;
+
+		return mapSection(shdr);
+	}
+
+	inline Elf32_Shdr* getSectionHeader(const char *name)
+	{
+		auto it = m_sectionIndex.find(name);
+
+		if (it == m_sectionIndex.end())
+			return nullptr;
 
-		return nullptr;
+		return &m_sections[it->second];
+	}
+
+	inline uint64_t getFileSize() const
+	{
+		return m_size;
 	}
 
 	inline Error getError() const
@@ -183,28 +328,284 @@ public:
 		return m_error;
 	}
 
+	// 64-bit safe file positioning, shared with the archive reader
+	static bool seek(FILE *file, uint64_t offset)
+	{
+#ifdef _WIN32
+		return _fseeki64(file, (__int64)offset, SEEK_SET) == 0;
+#else
+		return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+	}
+
+	static uint64_t getSize(FILE *file)
+	{
+#ifdef _WIN32
+		_fseeki64(file, 0, SEEK_END);
+		__int64 size = _ftelli64(file);
+#else
+		fseeko(file, 0, SEEK_END);
+		off_t size = ftello(file);
+#endif
+		seek(file, 0);
+
+		return size < 0 ? 0 : (uint64_t)size;
+	}
+
 	template<class T>
 	inline T read(void *data)
 	{
-		T x = *(T*)data;
+		T x;
+		memcpy(&x, data, sizeof(T));
+		return swap(x);
+	}
 
-		if (m_shouldReverseEndian)
+	template<class T>
+	inline void write(void *data, T x)
+	{
+		x = swap(x);
+		memcpy(data, &x, sizeof(T));
+	}
+
+	// Applies the relocations that target the given section. Only relocatable
+	// objects have any. Debugging information only uses word sized absolute
+	// relocations, so other relocation types are left alone and counted in
+	// outUnsupported. Returns false if a relocation is malformed.
+	bool relocateSection(Elf32_Shdr *target, int *outUnsupported = nullptr)
+	{
+		Elf32_Half targetIndex = (Elf32_Half)(target - m_sections.data());
+		int absoluteType = getAbsoluteRelocationType();
+		int unsupported = 0;
+
+		for (Elf32_Shdr &shdr : m_sections)
 		{
-			if (sizeof(T) == 2)
-				x = swap2((uint16_t)x);
-			else
-				x = swap4((uint32_t)x);
+			if ((shdr.sh_type != SHT_REL && shdr.sh_type != SHT_RELA) || shdr.sh_info != targetIndex)
+				continue;
+
+			if (shdr.sh_link >= m_sections.size() || m_sections[shdr.sh_link].sh_type != SHT_SYMTAB)
+				return false;
+
+			Elf32_Shdr *symtab = &m_sections[shdr.sh_link];
+			Elf32_Word numSymbols = symtab->sh_size / sizeof(Elf32_Sym);
+
+			bool isRela = (shdr.sh_type == SHT_RELA);
+			size_t entrySize = isRela ? sizeof(Elf32_Rela) : sizeof(Elf32_Rel);
+			char *rel = getSectionData(&shdr);
+			char *end = rel + shdr.sh_size / entrySize * entrySize;
+
+			for (; rel < end; rel += entrySize)
+			{
+				Elf32_Rela r;
+				r.r_offset = read<Elf32_Addr>(rel);
+				r.r_info = read<Elf32_Word>(rel + sizeof(Elf32_Addr));
+
+				if (ELF32_R_TYPE(r.r_info) != absoluteType)
+				{
+					unsupported++;
+					continue;
+				}
+
+				Elf32_Word symIndex = ELF32_R_SYM(r.r_info);
+
+				if (symIndex >= numSymbols || target->sh_size < sizeof(Elf32_Word) ||
+					r.r_offset > target->sh_size - sizeof(Elf32_Word))
+					return false;
+
+				Elf32_Sym *sym = (Elf32_Sym*)getSectionData(symtab) + symIndex;
+				char *p = getSectionData(target) + r.r_offset;
+
+				Elf32_Word value = read<Elf32_Addr>(&sym->st_value);
+				value += isRela ? (Elf32_Word)read<Elf32_Sword>(rel + 2 * sizeof(Elf32_Word)) : read<Elf32_Word>(p);
+
+				write<Elf32_Word>(p, value);
+			}
 		}
 
-		return x;
+		if (outUnsupported)
+			*outUnsupported = unsupported;
+
+		return true;
 	}
 
 private:
+	// A section mapped or read on demand in windowed mode
+	struct View
+	{
+		char *data;
+		char *buffer;
+		void *mapping;
+		size_t mappingSize;
+	};
+
 	Error m_error;
 	char *m_file;
+	uint64_t m_size;
+	bool m_ownsFile;
+	FILE *m_handle;
+	char m_header[sizeof(Elf32_Ehdr)];
+	std::vector<View> m_views;
 	bool m_shouldReverseEndian;
 
-	void loadFile(const char *filename)
+	template<class T>
+	inline T swap(T x)
+	{
+		if (m_shouldReverseEndian)
+		{
+			if (sizeof(T) == 2)
+				x = (T)swap2((uint16_t)x);
+			else if (sizeof(T) == 4)
+				x = (T)swap4((uint32_t)x);
+			else if (sizeof(T) == 8)
+			{
+				uint64_t v = (uint64_t)x;
+				uint32_t hi = (uint32_t)(v >> 32);
+				uint32_t lo = (uint32_t)v;
+				x = (T)(((uint64_t)swap4(lo) << 32) | swap4(hi));
+			}
+		}
+
+		return x;
+	}
+
+	// The 32-bit absolute relocation type of the file's machine
+	int getAbsoluteRelocationType()
+	{
+		switch (getMachine())
+		{
+		case EM_SPARC:
+			return 3; // R_SPARC_32
+		case EM_MIPS:
+		case EM_ARM:
+			return 2; // R_MIPS_32, R_ARM_ABS32
+		default:
+			return 1; // R_386_32, R_68K_32, R_PPC_ADDR32
+		}
+	}
+
+	void init()
+	{
+		if (m_size < sizeof(Elf32_Ehdr))
+		{
+			m_error = ERR_INVALID_HEADER;
+			return;
+		}
+
+		initEndian();
+
+		Elf32_Ehdr *ehdr = getElfHeader();
+
+		if (ehdr->e_ident[EI_MAG0] != 0x7f ||
+			ehdr->e_ident[EI_MAG1] != 'E' ||
+			ehdr->e_ident[EI_MAG2] != 'L' ||
+			ehdr->e_ident[EI_MAG3] != 'F' ||
+			ehdr->e_ident[EI_CLASS] != ELFCLASS32 ||
+			ehdr->e_ident[EI_DATA] == ELFDATANONE ||
+			ehdr->e_ident[EI_VERSION] == EV_NONE ||
+			read<Elf32_Half>(&ehdr->e_ehsize) != sizeof(Elf32_Ehdr) ||
+			read<Elf32_Half>(&ehdr->e_shentsize) != sizeof(Elf32_Shdr) ||
+			read<Elf32_Word>(&ehdr->e_version) == EV_NONE)
+		{
+			m_error = ERR_INVALID_HEADER;
+			return;
+		}
+
+		loadSectionTable();
+	}
+	std::vector<Elf32_Shdr> m_sections;
+	std::unordered_map<std::string, Elf32_Half> m_sectionIndex;
+	Elf32_Shdr *m_sectionNames;
+
+	// Copies every section header into host byte order, checks that the headers
+	// and section contents lie within the file, and indexes the sections by name.
+	void loadSectionTable()
+	{
+		Elf32_Ehdr *ehdr = getElfHeader();
+
+		Elf32_Off shoff = read<Elf32_Off>(&ehdr->e_shoff);
+		Elf32_Half shnum = read<Elf32_Half>(&ehdr->e_shnum);
+		Elf32_Half shstrndx = read<Elf32_Half>(&ehdr->e_shstrndx);
+
+		if (shoff > m_size || (size_t)shnum * sizeof(Elf32_Shdr) > m_size - shoff ||
+			shstrndx >= shnum)
+		{
+			m_error = ERR_INVALID_SECTION;
+			return;
+		}
+
+		m_sections.resize(shnum);
+
+		std::vector<Elf32_Shdr> rawHeaders;
+		Elf32_Shdr *rawTable = (Elf32_Shdr*)(m_file + shoff);
+
+		if (!m_file)
+		{
+			rawHeaders.resize(shnum);
+			rawTable = rawHeaders.data();
+
+			if (!readAt(shoff, (char*)rawTable, (size_t)shnum * sizeof(Elf32_Shdr)))
+			{
+				m_error = ERR_FILE_READ;
+				return;
+			}
+		}
+
+		for (Elf32_Half i = 0; i < shnum; i++)
+		{
+			Elf32_Shdr *raw = rawTable + i;
+			Elf32_Shdr *shdr = &m_sections[i];
+
+			shdr->sh_name = read<Elf32_Word>(&raw->sh_name);
+			shdr->sh_type = read<Elf32_Word>(&raw->sh_type);
+			shdr->sh_flags = read<Elf32_Word>(&raw->sh_flags);
+			shdr->sh_addr = read<Elf32_Addr>(&raw->sh_addr);
+			shdr->sh_offset = read<Elf32_Off>(&raw->sh_offset);
+			shdr->sh_size = read<Elf32_Word>(&raw->sh_size);
+			shdr->sh_link = read<Elf32_Word>(&raw->sh_link);
+			shdr->sh_info = read<Elf32_Word>(&raw->sh_info);
+			shdr->sh_addralign = read<Elf32_Word>(&raw->sh_addralign);
+			shdr->sh_entsize = read<Elf32_Word>(&raw->sh_entsize);
+
+			// NOBITS sections take up no space in the file
+			if (shdr->sh_type != SHT_NOBITS && shdr->sh_type != SHT_NULL &&
+				(shdr->sh_offset > m_size || shdr->sh_size > m_size - shdr->sh_offset))
+			{
+				m_error = ERR_INVALID_SECTION;
+				return;
+			}
+		}
+
+		m_sectionNames = &m_sections[shstrndx];
+		m_views.resize(shnum, View());
+
+		// The string table must be terminated so names can't run off its end
+		if (m_sectionNames->sh_size == 0 ||
+			getSectionData(m_sectionNames)[m_sectionNames->sh_size - 1] != '\0')
+		{
+			m_error = ERR_INVALID_SECTION;
+			return;
+		}
+
+		m_sectionIndex.reserve(shnum);
+
+		for (Elf32_Half i = 0; i < shnum; i++)
+		{
+			if (m_sections[i].sh_name >= m_sectionNames->sh_size)
+			{
+				m_error = ERR_INVALID_SECTION;
+				return;
+			}
+
+			// Like a linear search, the first section with a given name wins
+			m_sectionIndex.emplace(getSectionName(&m_sections[i]), i);
+		}
+	}
+
+	bool readAt(uint64_t offset, char *buffer, size_t size)
+	{
+		return seek(m_handle, offset) && fread(buffer, 1, size, m_handle) == size;
+	}
+
+	void loadFile(const char *filename, LoadMode mode)
 	{
 		FILE *file = fopen(filename, "rb");
 
@@ -214,9 +615,7 @@ private:
 			return;
 		}
 
-		fseek(file, 0, SEEK_END);
-		int size = ftell(file);
-		fseek(file, 0, SEEK_SET);
+		uint64_t size = getSize(file);
 
 		if (size == 0)
 		{
@@ -225,15 +624,66 @@ private:
 			return;
 		}
 
-		m_file = new char[size];
+		m_size = size;
+
+		// Files that don't fit in the address space can only be windowed
+		if (mode == LOAD_WINDOWED || size > SIZE_MAX ||
+			(mode == LOAD_AUTO && size > ELF_WINDOWED_THRESHOLD))
+		{
+			m_handle = file;
+
+			if (!readAt(0, m_header, (size_t)std::min<uint64_t>(size, sizeof(m_header))))
+				memset(m_header, 0, sizeof(m_header));
+
+			return;
+		}
+
+		m_file = new char[(size_t)size];
 
-		size_t bytesRead = fread(m_file, sizeof(char), size, file);
+		size_t bytesRead = fread(m_file, sizeof(char), (size_t)size, file);
 		fclose(file);
 
-		if (bytesRead != size)
-		{
+		if (bytesRead != (size_t)size)
 			m_error = ERR_FILE_READ;
+	}
+
+	// Maps the section's pages of the file, copy-on-write so relocations can be
+	// applied, or reads the section where mapping isn't available.
+	char* mapSection(Elf32_Shdr *shdr)
+	{
+		View &view = m_views[shdr - m_sections.data()];
+
+		if (view.data)
+			return view.data;
+
+		size_t size = (shdr->sh_type == SHT_NOBITS) ? 0 : shdr->sh_size;
+
+#ifndef _WIN32
+		if (size > 0)
+		{
+			uint64_t pageSize = (uint64_t)sysconf(_SC_PAGESIZE);
+			uint64_t base = shdr->sh_offset / pageSize * pageSize;
+			size_t delta = (size_t)(shdr->sh_offset - base);
+
+			void *mapping = mmap(nullptr, size + delta, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(m_handle), (off_t)base);
+
+			if (mapping != MAP_FAILED)
+			{
+				view.mapping = mapping;
+				view.mappingSize = size + delta;
+				view.data = (char*)mapping + delta;
+				return view.data;
+			}
 		}
+#endif
+
+		view.buffer = new char[size + ELF_SECTION_PADDING]();
+		view.data = view.buffer;
+
+		if (size > 0 && !readAt(shdr->sh_offset, view.buffer, size))
+			m_error = ERR_FILE_READ;
+
+		return view.data;
 	}
 
 	inline void initEndian()
@@ -0,0 +1,327 @@
+#include "export.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+
+class ExportWriter
+{
+public:
+	ExportWriter()
+	{
+		m_strings.push_back('\0');
+		m_stringOffsets[""] = 0;
+	}
+
+	void add(std::vector<Cpp::File*> &files)
+	{
+		// Types can refer to types that come later, so number them all first
+		uint32_t index = 0;
+
+		for (Cpp::File *cpp : files)
+		{
+			for (Cpp::UserType *ut : cpp->userTypes)
+				m_typeIndices[ut] = index++;
+		}
+
+		for (size_t i = 0; i < files.size(); i++)
+			addFile(files[i], (uint32_t)i);
+	}
+
+	bool write(const char *filename)
+	{
+		ExportHeader header = {};
+		uint32_t offset = sizeof(ExportHeader);
+
+		header.magic = EXPORT_MAGIC;
+		header.version = EXPORT_VERSION;
+
+		placeTable(m_files, &offset, &header.fileOffset, &header.fileCount);
+		placeTable(m_types, &offset, &header.typeOffset, &header.typeCount);
+		placeTable(m_members, &offset, &header.memberOffset, &header.memberCount);
+		placeTable(m_bases, &offset, &header.baseOffset, &header.baseCount);
+		placeTable(m_enumerators, &offset, &header.enumeratorOffset, &header.enumeratorCount);
+		placeTable(m_dimensions, &offset, &header.dimensionOffset, &header.dimensionCount);
+		placeTable(m_parameters, &offset, &header.parameterOffset, &header.parameterCount);
+		placeTable(m_functions, &offset, &header.functionOffset, &header.functionCount);
+		placeTable(m_variables, &offset, &header.variableOffset, &header.variableCount);
+		placeTable(m_lines, &offset, &header.lineOffset, &header.lineCount);
+
+		header.stringOffset = offset;
+		header.stringSize = (uint32_t)m_strings.size();
+		header.fileSize = offset + header.stringSize;
+
+		std::ofstream file(filename, std::ios::binary);
+
+		if (!file)
+			return false;
+
+		writeWords(file, &header, 1);
+		writeWords(file, m_files.data(), m_files.size());
+		writeWords(file, m_types.data(), m_types.size());
+		writeWords(file, m_members.data(), m_members.size());
+		writeWords(file, m_bases.data(), m_bases.size());
+		writeWords(file, m_enumerators.data(), m_enumerators.size());
+		writeWords(file, m_dimensions.data(), m_dimensions.size());
+		writeWords(file, m_parameters.data(), m_parameters.size());
+		writeWords(file, m_functions.data(), m_functions.size());
+		writeWords(file, m_variables.data(), m_variables.size());
+		writeWords(file, m_lines.data(), m_lines.size());
+		file.write(m_strings.data(), m_strings.size());
+
+		return file.good();
+	}
+
+private:
+	std::vector<char> m_strings;
+	std::unordered_map<std::string, uint32_t> m_stringOffsets;
+	std::unordered_map<Cpp::UserType*, uint32_t> m_typeIndices;
+
+	std::vector<ExportFile> m_files;
+	std::vector<ExportType> m_types;
+	std::vector<ExportMember> m_members;
+	std::vector<ExportBase> m_bases;
+	std::vector<ExportEnumerator> m_enumerators;
+	std::vector<ExportDimension> m_dimensions;
+	std::vector<ExportParameter> m_parameters;
+	std::vector<ExportFunction> m_functions;
+	std::vector<ExportVariable> m_variables;
+	std::vector<ExportLine> m_lines;
+
+	template<typename T>
+	static void placeTable(std::vector<T> &table, uint32_t *offset, uint32_t *outOffset, uint32_t *outCount)
+	{
+		static_assert(sizeof(T) % 4 == 0, "Export tables must be made of 32-bit words.");
+
+		*outOffset = *offset;
+		*outCount = (uint32_t)table.size();
+		*offset += (uint32_t)(table.size() * sizeof(T));
+	}
+
+	// Writes an array of structs made of 32-bit words in little-endian order
+	template<typename T>
+	static void writeWords(std::ofstream &file, const T *data, size_t count)
+	{
+		const uint16_t one = 1;
+		size_t size = count * sizeof(T);
+
+		if (*(const char*)&one == 1)
+		{
+			file.write((const char*)data, size);
+			return;
+		}
+
+		std::vector<char> swapped((const char*)data, (const char*)data + size);
+
+		for (size_t i = 0; i < size; i += 4)
+		{
+			std::swap(swapped[i], swapped[i + 3]);
+			std::swap(swapped[i + 1], swapped[i + 2]);
+		}
+
+		file.write(swapped.data(), size);
+	}
+
+	uint32_t addString(const std::string &str)
+	{
+		auto it = m_stringOffsets.find(str);
+
+		if (it != m_stringOffsets.end())
+			return it->second;
+
+		uint32_t offset = (uint32_t)m_strings.size();
+		m_strings.insert(m_strings.end(), str.begin(), str.end());
+		m_strings.push_back('\0');
+		m_stringOffsets[str] = offset;
+
+		return offset;
+	}
+
+	ExportTypeRef toTypeRef(Cpp::Type &type)
+	{
+		ExportTypeRef ref;
+
+		if (type.isFundamentalType)
+			ref.type = EXPORT_FUNDAMENTAL | (uint32_t)type.fundamentalType;
+		else
+			ref.type = m_typeIndices.count(type.userType) ? m_typeIndices[type.userType] : EXPORT_NONE;
+
+		size_t count = std::min<size_t>(type.modifiers.size(), EXPORT_MAX_MODIFIERS);
+		ref.modifiers = 0;
+
+		for (size_t i = 0; i < count; i++)
+		{
+			uint32_t modifier = (uint32_t)type.modifiers[i];
+
+			// Only bad data has values that don't fit
+			if (modifier > 3)
+			{
+				count = i;
+				break;
+			}
+
+			ref.modifiers |= modifier << (4 + i * 2);
+		}
+
+		ref.modifiers |= (uint32_t)count;
+
+		if (count < type.modifiers.size())
+			ref.modifiers |= EXPORT_MODIFIERS_TRUNCATED;
+
+		return ref;
+	}
+
+	ExportTypeRef toTypeRef(Cpp::FundamentalType ft)
+	{
+		return { EXPORT_FUNDAMENTAL | (uint32_t)ft, 0 };
+	}
+
+	uint32_t addVariables(Cpp::Vector<Cpp::Variable> &variables)
+	{
+		uint32_t first = (uint32_t)m_variables.size();
+
+		for (Cpp::Variable &var : variables)
+			m_variables.push_back({ addString(var.name), var.isGlobal, toTypeRef(var.type) });
+
+		return first;
+	}
+
+	uint32_t addParameters(Cpp::Vector<Cpp::FunctionType::Parameter> &parameters)
+	{
+		uint32_t first = (uint32_t)m_parameters.size();
+
+		for (Cpp::FunctionType::Parameter &p : parameters)
+			m_parameters.push_back({ addString(p.name), toTypeRef(p.type) });
+
+		return first;
+	}
+
+	void addFile(Cpp::File *cpp, uint32_t fileIndex)
+	{
+		ExportFile file;
+		file.name = addString(cpp->filename);
+		file.firstType = (uint32_t)m_types.size();
+		file.typeCount = (uint32_t)cpp->userTypes.size();
+
+		for (Cpp::UserType *ut : cpp->userTypes)
+			addType(ut, fileIndex);
+
+		file.firstVariable = addVariables(cpp->variables);
+		file.variableCount = (uint32_t)cpp->variables.size();
+
+		file.firstFunction = (uint32_t)m_functions.size();
+		file.functionCount = (uint32_t)cpp->functions.size();
+
+		for (Cpp::Function &fun : cpp->functions)
+			addFunction(fun, fileIndex);
+
+		m_files.push_back(file);
+	}
+
+	void addType(Cpp::UserType *ut, uint32_t fileIndex)
+	{
+		ExportType type = {};
+		type.kind = (uint32_t)ut->type;
+		type.name = addString(ut->name);
+		type.file = fileIndex;
+		type.firstBase = (uint32_t)m_bases.size();
+		type.elementType = { EXPORT_NONE, 0 };
+
+		const Cpp::Layout &layout = ut->getLayout();
+		type.size = (uint32_t)layout.size;
+		type.alignment = (uint32_t)layout.alignment;
+
+		switch (ut->type)
+		{
+		case Cpp::UserType::CLASS:
+		case Cpp::UserType::STRUCT:
+		case Cpp::UserType::UNION:
+			type.firstChild = (uint32_t)m_members.size();
+			type.childCount = (uint32_t)ut->classData->members.size();
+
+			for (Cpp::ClassType::Member &m : ut->classData->members)
+				m_members.push_back({ addString(m.name), (uint32_t)m.offset, m.bit_offset, m.bit_size, toTypeRef(m.type) });
+
+			type.baseCount = (uint32_t)ut->classData->inheritances.size();
+
+			for (Cpp::ClassType::Inheritance &i : ut->classData->inheritances)
+				m_bases.push_back({ (uint32_t)i.offset, toTypeRef(i.type) });
+
+			break;
+		case Cpp::UserType::ENUM:
+			type.firstChild = (uint32_t)m_enumerators.size();
+			type.childCount = (uint32_t)ut->enumData->elements.size();
+			type.elementType = toTypeRef(ut->enumData->baseType);
+
+			for (Cpp::EnumType::Element &e : ut->enumData->elements)
+				m_enumerators.push_back({ addString(e.name), (int32_t)e.constValue });
+
+			break;
+		case Cpp::UserType::ARRAY:
+			type.firstChild = (uint32_t)m_dimensions.size();
+			type.childCount = (uint32_t)ut->arrayData->dimensions.size();
+			type.elementType = toTypeRef(ut->arrayData->type);
+
+			for (Cpp::ArrayType::Dimension &d : ut->arrayData->dimensions)
+				m_dimensions.push_back({ (uint32_t)d.size });
+
+			break;
+		case Cpp::UserType::FUNCTION:
+			type.childCount = (uint32_t)ut->functionData->parameters.size();
+			type.firstChild = addParameters(ut->functionData->parameters);
+			type.elementType = toTypeRef(ut->functionData->returnType);
+			break;
+		}
+
+		m_types.push_back(type);
+	}
+
+	void addFunction(Cpp::Function &fun, uint32_t fileIndex)
+	{
+		ExportFunction function;
+		function.name = addString(fun.name);
+		function.mangledName = addString(fun.mangledName);
+		function.file = fileIndex;
+		function.owner = (fun.typeOwner && m_typeIndices.count(fun.typeOwner)) ? m_typeIndices[fun.typeOwner] : EXPORT_NONE;
+		function.isGlobal = fun.isGlobal;
+		function.startAddress = fun.startAddress;
+		function.endAddress = fun.endAddress;
+		function.size = fun.size;
+		function.returnType = toTypeRef(fun.returnType);
+		function.parameterCount = (uint32_t)fun.parameters.size();
+		function.firstParameter = addParameters(fun.parameters);
+		function.variableCount = (uint32_t)fun.variables.size();
+		function.firstVariable = addVariables(fun.variables);
+		function.firstLine = (uint32_t)m_lines.size();
+
+		if (fun.dwarf != nullptr)
+		{
+			auto range = fun.dwarf->lineEntryMap.equal_range(fun.startAddress);
+
+			for (auto it = range.first; it != range.second; ++it)
+				m_lines.push_back({ fun.startAddress + it->second.hexAddressOffset, (uint32_t)it->second.lineNumber, it->second.charOffset });
+		}
+
+		function.lineCount = (uint32_t)m_lines.size() - function.firstLine;
+
+		m_functions.push_back(function);
+	}
+};
+
+bool writeExport(std::vector<Cpp::File*> &files, const char *filename)
+{
+	ExportWriter writer;
+	writer.add(files);
+
+	std::cout << "Writing export file " << filename << "..." << std::endl;
+
+	if (!writer.write(filename))
+	{
+		std::cout << "Failed to write " << filename << "." << std::endl;
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,158 @@
+/**************************************************************/
+/* Flat binary export of the converted program, for tools    */
+/* that want the type graph without parsing the C++ output.  */
+/**************************************************************/
+
+// Layout:
+//   ExportHeader, then every table at the offset the header gives for it,
+//   each an array of the struct below with the given count.
+//
+// Everything except the string table is made of 32-bit little-endian words,
+// and every table starts 4-byte aligned, so a little-endian consumer can map
+// the file and index the tables directly. Other values:
+//   - Strings are offsets into the string table, and are null terminated.
+//     Offset 0 is the empty string.
+//   - References to other entries are indices into their table, with
+//     EXPORT_NONE for none.
+//   - Ranges are a first index and a count.
+
+#pragma once
+
+#include "cpp.h"
+
+#include <cstdint>
+#include <vector>
+
+#define EXPORT_MAGIC   0x58433244 // "D2CX"
+#define EXPORT_VERSION 2
+#define EXPORT_NONE    0xffffffff
+
+// A type used by a member, parameter, variable etc. If the high bit of type
+// is set, the rest of it is a Cpp::FundamentalType, otherwise it's an index
+// into the type table. modifiers holds the modifier count in the low 4 bits,
+// followed by up to EXPORT_MAX_MODIFIERS Cpp::Type::Modifier values of 2 bits
+// each, in the order of Cpp::Type::modifiers. If a type has more modifiers, or
+// one that doesn't fit in 2 bits, only those before it are stored and
+// EXPORT_MODIFIERS_TRUNCATED is set.
+struct ExportTypeRef
+{
+	uint32_t type;
+	uint32_t modifiers;
+};
+
+#define EXPORT_FUNDAMENTAL         0x80000000
+#define EXPORT_MAX_MODIFIERS       13
+#define EXPORT_MODIFIERS_TRUNCATED 0x80000000
+
+struct ExportHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t fileSize;
+
+	uint32_t stringOffset, stringSize;
+	uint32_t fileOffset, fileCount;
+	uint32_t typeOffset, typeCount;
+	uint32_t memberOffset, memberCount;
+	uint32_t baseOffset, baseCount;
+	uint32_t enumeratorOffset, enumeratorCount;
+	uint32_t dimensionOffset, dimensionCount;
+	uint32_t parameterOffset, parameterCount;
+	uint32_t functionOffset, functionCount;
+	uint32_t variableOffset, variableCount;
+	uint32_t lineOffset, lineCount;
+};
+
+// A compile unit
+struct ExportFile
+{
+	uint32_t name;
+	uint32_t firstType, typeCount;
+	uint32_t firstFunction, functionCount;
+	uint32_t firstVariable, variableCount;
+};
+
+struct ExportType
+{
+	uint32_t kind; // Cpp::UserType's type
+	uint32_t name;
+	uint32_t file;
+	uint32_t size;
+	uint32_t alignment;
+
+	// Members (class, struct, union), enumerators (enum), dimensions (array)
+	// or parameters (function type)
+	uint32_t firstChild, childCount;
+
+	// Base classes
+	uint32_t firstBase, baseCount;
+
+	// Element type of an array, return type of a function type,
+	// or the fundamental base type of an enum
+	ExportTypeRef elementType;
+};
+
+struct ExportMember
+{
+	uint32_t name;
+	uint32_t offset;
+	int32_t bitOffset; // -1 if not a bitfield
+	int32_t bitSize;   // -1 if not a bitfield
+	ExportTypeRef type;
+};
+
+struct ExportBase
+{
+	uint32_t offset;
+	ExportTypeRef type;
+};
+
+struct ExportEnumerator
+{
+	uint32_t name;
+	int32_t value;
+};
+
+struct ExportDimension
+{
+	uint32_t size;
+};
+
+struct ExportParameter
+{
+	uint32_t name;
+	ExportTypeRef type;
+};
+
+struct ExportFunction
+{
+	uint32_t name;
+	uint32_t mangledName;
+	uint32_t file;
+	uint32_t owner; // Type index of the class this is a method of
+	uint32_t isGlobal;
+	uint32_t startAddress;
+	uint32_t endAddress;
+	uint32_t size;
+	ExportTypeRef returnType;
+	uint32_t firstParameter, parameterCount;
+	uint32_t firstVariable, variableCount; // Local variables
+	uint32_t firstLine, lineCount;
+};
+
+struct ExportVariable
+{
+	uint32_t name;
+	uint32_t isGlobal;
+	ExportTypeRef type;
+};
+
+struct ExportLine
+{
+	uint32_t address;
+	uint32_t line; // 0 marks the end of the function
+	int32_t character; // -1 if unknown
+};
+
+// Writes the export for files to filename. Returns false if the file couldn't be written.
+bool writeExport(std::vector<Cpp::File*> &files, const char *filename);
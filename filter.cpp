@@ -0,0 +1,97 @@
+#include "filter.h"
+
+#include <cctype>
+
+static inline bool isSlash(char c)
+{
+	return c == '/' || c == '\\';
+}
+
+static inline bool charMatches(char p, char c, bool path)
+{
+	if (!path)
+		return p == c;
+
+	if (isSlash(p))
+		return isSlash(c);
+
+	return tolower((unsigned char)p) == tolower((unsigned char)c);
+}
+
+bool globMatch(const char *pattern, const char *text, size_t length, bool path)
+{
+	const char *p = pattern;
+	const char *star = nullptr;
+	size_t t = 0;
+	size_t starText = 0;
+
+	// Backtracks to the last '*' on a mismatch, which is enough since a later
+	// '*' can match anything an earlier one could
+	while (t < length)
+	{
+		if (*p == '*')
+		{
+			star = p++;
+			starText = t;
+		}
+		else if (*p && (*p == '?' || charMatches(*p, text[t], path)))
+		{
+			p++;
+			t++;
+		}
+		else if (star)
+		{
+			p = star + 1;
+			t = ++starText;
+		}
+		else
+			return false;
+	}
+
+	while (*p == '*')
+		p++;
+
+	return *p == '\0';
+}
+
+bool NameFilter::matches(const char *name, size_t length) const
+{
+	if (!m_include.empty() && !matchesAny(m_include, name, length))
+		return false;
+
+	return !matchesAny(m_exclude, name, length);
+}
+
+bool NameFilter::matches(const char *name, size_t length, const char *alias, size_t aliasLength) const
+{
+	if (!alias)
+		return matches(name, length);
+
+	if (!m_include.empty() && !matchesAny(m_include, name, length) && !matchesAny(m_include, alias, aliasLength))
+		return false;
+
+	return !matchesAny(m_exclude, name, length) && !matchesAny(m_exclude, alias, aliasLength);
+}
+
+bool NameFilter::matchesAny(const std::vector<std::string> &patterns, const char *name, size_t length) const
+{
+	for (const std::string &pattern : patterns)
+	{
+		if (!m_paths)
+		{
+			if (globMatch(pattern.c_str(), name, length, false))
+				return true;
+
+			continue;
+		}
+
+		// Try the whole path, then everything after each slash
+		for (size_t i = 0; i < length; i++)
+		{
+			if ((i == 0 || isSlash(name[i - 1])) && globMatch(pattern.c_str(), name + i, length - i, true))
+				return true;
+		}
+	}
+
+	return false;
+}
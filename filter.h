@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Matches text against a glob pattern, where '*' matches any run of
+// characters and '?' any single character. Paths are matched without regard
+// to case or to the kind of slash.
+bool globMatch(const char *pattern, const char *text, size_t length, bool path);
+
+// Include and exclude lists of glob patterns. A name passes if it matches an
+// include pattern (or there are none) and no exclude pattern. Path patterns
+// may match any trailing part of a path, so "SB/Game/*" matches
+// "C:\SB\Game\zNPC.cpp".
+class NameFilter
+{
+public:
+	NameFilter(bool paths = false) : m_paths(paths)
+	{
+	}
+
+	inline void include(const std::string &pattern)
+	{
+		m_include.push_back(pattern);
+	}
+
+	inline void exclude(const std::string &pattern)
+	{
+		m_exclude.push_back(pattern);
+	}
+
+	inline bool isActive() const
+	{
+		return !m_include.empty() || !m_exclude.empty();
+	}
+
+	bool matches(const char *name, size_t length) const;
+
+	inline bool matches(const std::string &name) const
+	{
+		return matches(name.data(), name.size());
+	}
+
+	// For names with a second spelling, like a function's mangled name. Either
+	// spelling may match an include pattern, but neither may match an exclude
+	// pattern. alias may be null.
+	bool matches(const char *name, size_t length, const char *alias, size_t aliasLength) const;
+
+private:
+	bool m_paths;
+	std::vector<std::string> m_include;
+	std::vector<std::string> m_exclude;
+
+	bool matchesAny(const std::vector<std::string> &patterns, const char *name, size_t length) const;
+};
+
+// Selects the part of a program that's extracted
+struct ExtractFilter
+{
+	NameFilter compileUnits = NameFilter(true);
+	NameFilter types;
+	NameFilter functions;
+};
@@ -0,0 +1,42 @@
+/*************************************************************/
+/* 64-bit FNV-1a hashing of values, strings and raw bytes,   */
+/* for fingerprinting types and compile units.               */
+/*************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#define FNV_OFFSET 0xcbf29ce484222325ull
+#define FNV_PRIME  0x100000001b3ull
+
+static inline uint64_t hashBytes(uint64_t h, const char *data, size_t size)
+{
+	for (size_t i = 0; i < size; i++)
+	{
+		h ^= (unsigned char)data[i];
+		h *= FNV_PRIME;
+	}
+
+	return h;
+}
+
+// Mixes in all 8 bytes, so values of different widths hash the same
+static inline uint64_t hashMix(uint64_t h, uint64_t value)
+{
+	for (int i = 0; i < 8; i++)
+	{
+		h ^= (value >> (i * 8)) & 0xff;
+		h *= FNV_PRIME;
+	}
+
+	return h;
+}
+
+// The length is mixed in too, so consecutive strings can't run together
+static inline uint64_t hashMix(uint64_t h, const std::string &str)
+{
+	return hashMix(hashBytes(h, str.data(), str.size()), str.size());
+}
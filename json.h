@@ -0,0 +1,274 @@
+/*****************************************************/
+/* Minimal JSON support for the line based protocols */
+/* Requests are flat objects of strings and numbers. */
+/*****************************************************/
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <sstream>
+
+namespace Json
+{
+struct Value
+{
+	bool isString;
+	std::string string;
+	double number;
+};
+
+typedef std::map<std::string, Value> Object;
+
+inline void skipSpace(const char *&p)
+{
+	while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+		p++;
+}
+
+inline bool parseString(const char *&p, std::string *out)
+{
+	if (*p != '"')
+		return false;
+
+	p++;
+
+	while (*p && *p != '"')
+	{
+		if (*p == '\\')
+		{
+			p++;
+
+			switch (*p)
+			{
+			case 'n': *out += '\n'; break;
+			case 't': *out += '\t'; break;
+			case 'r': *out += '\r'; break;
+			case 'b': *out += '\b'; break;
+			case 'f': *out += '\f'; break;
+			case 'u':
+			{
+				// Only the basic latin range is expected in requests
+				char hex[5] = { 0 };
+
+				for (int i = 0; i < 4; i++)
+				{
+					if (!p[i + 1])
+						return false;
+					hex[i] = p[i + 1];
+				}
+
+				*out += (char)strtol(hex, nullptr, 16);
+				p += 4;
+				break;
+			}
+			case '\0':
+				return false;
+			default:
+				*out += *p;
+				break;
+			}
+
+			p++;
+		}
+		else
+			*out += *p++;
+	}
+
+	if (*p != '"')
+		return false;
+
+	p++;
+	return true;
+}
+
+// Returns the end of the number at p, or null if p doesn't start one. Only
+// JSON's syntax is accepted, so the text can be echoed back as it is.
+inline const char* scanNumber(const char *p)
+{
+	if (*p == '-')
+		p++;
+
+	if (*p == '0')
+		p++;
+	else if (*p >= '1' && *p <= '9')
+	{
+		while (*p >= '0' && *p <= '9')
+			p++;
+	}
+	else
+		return nullptr;
+
+	if (*p == '.')
+	{
+		p++;
+
+		if (*p < '0' || *p > '9')
+			return nullptr;
+
+		while (*p >= '0' && *p <= '9')
+			p++;
+	}
+
+	if (*p == 'e' || *p == 'E')
+	{
+		p++;
+
+		if (*p == '+' || *p == '-')
+			p++;
+
+		if (*p < '0' || *p > '9')
+			return nullptr;
+
+		while (*p >= '0' && *p <= '9')
+			p++;
+	}
+
+	return p;
+}
+
+// Parses a single flat object. Nested objects and arrays are not supported.
+inline bool parseObject(const std::string &text, Object *out)
+{
+	const char *p = text.c_str();
+
+	skipSpace(p);
+
+	if (*p++ != '{')
+		return false;
+
+	skipSpace(p);
+
+	if (*p == '}')
+		return true;
+
+	for (;;)
+	{
+		std::string key;
+		Value value;
+
+		skipSpace(p);
+
+		if (!parseString(p, &key))
+			return false;
+
+		skipSpace(p);
+
+		if (*p++ != ':')
+			return false;
+
+		skipSpace(p);
+
+		if (*p == '"')
+		{
+			value.isString = true;
+			value.number = 0;
+
+			if (!parseString(p, &value.string))
+				return false;
+		}
+		else
+		{
+			const char *end = scanNumber(p);
+
+			if (!end)
+				return false;
+
+			value.isString = false;
+			value.string.assign(p, end - p);
+			value.number = strtod(value.string.c_str(), nullptr);
+			p = end;
+		}
+
+		(*out)[key] = value;
+
+		skipSpace(p);
+
+		if (*p == ',')
+		{
+			p++;
+			continue;
+		}
+
+		return *p == '}';
+	}
+}
+
+inline std::string escape(const std::string &str)
+{
+	std::string result;
+	result.reserve(str.size() + 2);
+	result += '"';
+
+	for (char c : str)
+	{
+		switch (c)
+		{
+		case '"': result += "\\\""; break;
+		case '\\': result += "\\\\"; break;
+		case '\n': result += "\\n"; break;
+		case '\r': result += "\\r"; break;
+		case '\t': result += "\\t"; break;
+		default:
+			if ((unsigned char)c < 0x20)
+			{
+				char buf[8];
+				snprintf(buf, sizeof(buf), "\\u%04x", (unsigned char)c);
+				result += buf;
+			}
+			else
+				result += c;
+			break;
+		}
+	}
+
+	result += '"';
+	return result;
+}
+
+// Reads a number that may also be given as a string, e.g. "0x80001000".
+inline bool getUnsigned(const Object &obj, const char *key, uint64_t *out)
+{
+	auto it = obj.find(key);
+
+	if (it == obj.end())
+		return false;
+
+	if (it->second.isString)
+	{
+		const char *str = it->second.string.c_str();
+
+		// strtoull would wrap negative values around
+		if (*str == '-')
+			return false;
+
+		char *end;
+		*out = strtoull(str, &end, 0);
+		return end != str && *end == '\0';
+	}
+
+	double number = it->second.number;
+
+	// Anything else can't be converted
+	if (!(number >= 0 && number < 18446744073709551616.0 && number == floor(number)))
+		return false;
+
+	*out = (uint64_t)number;
+	return true;
+}
+
+inline bool getString(const Object &obj, const char *key, std::string *out)
+{
+	auto it = obj.find(key);
+
+	if (it == obj.end() || !it->second.isString)
+		return false;
+
+	*out = it->second.string;
+	return true;
+}
+}
@@ -0,0 +1,40 @@
+#include "memstats.h"
+
+#include <iomanip>
+
+namespace MemStats
+{
+	std::atomic<bool> enabled(false);
+	Counter counters[MEM_CATEGORY_COUNT];
+
+	static const char *categoryNames[MEM_CATEGORY_COUNT] =
+	{
+		"DWARF entries",
+		"DWARF reference map",
+		"DWARF line table",
+		"C++ model",
+		"Rendered output"
+	};
+
+	void report(std::ostream &out, const char *phase)
+	{
+		if (!isEnabled())
+			return;
+
+		out << "Memory " << phase << ":" << std::endl;
+		out << "\t" << std::left << std::setw(22) << "Category" << std::right <<
+			std::setw(14) << "Live bytes" << std::setw(14) << "Peak bytes" << std::setw(14) << "Allocations" << std::endl;
+
+		for (int i = 0; i < MEM_CATEGORY_COUNT; i++)
+		{
+			Counter &c = counters[i];
+
+			out << "\t" << std::left << std::setw(22) << categoryNames[i] << std::right <<
+				std::setw(14) << c.live.load() <<
+				std::setw(14) << c.peak.load() <<
+				std::setw(14) << c.allocations.load() << std::endl;
+		}
+
+		out << std::endl;
+	}
+}
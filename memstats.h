@@ -0,0 +1,107 @@
+/**************************************************************/
+/* Optional accounting of the memory held by the main        */
+/* containers, per subsystem.                                 */
+/**************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+
+enum MemCategory
+{
+	MEM_DWARF_ENTRIES,
+	MEM_DWARF_REFS,
+	MEM_DWARF_LINES,
+	MEM_CPP_MODEL,
+	MEM_RENDERED,
+	MEM_CATEGORY_COUNT
+};
+
+namespace MemStats
+{
+	struct Counter
+	{
+		std::atomic<int64_t> live;
+		std::atomic<int64_t> peak;
+		std::atomic<int64_t> allocations;
+	};
+
+	extern std::atomic<bool> enabled;
+	extern Counter counters[MEM_CATEGORY_COUNT];
+
+	inline bool isEnabled()
+	{
+		return enabled.load(std::memory_order_relaxed);
+	}
+
+	inline void allocate(MemCategory category, size_t bytes)
+	{
+		if (!isEnabled())
+			return;
+
+		Counter &c = counters[category];
+		int64_t live = c.live.fetch_add((int64_t)bytes, std::memory_order_relaxed) + (int64_t)bytes;
+		int64_t peak = c.peak.load(std::memory_order_relaxed);
+
+		while (live > peak && !c.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed));
+
+		c.allocations.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	inline void release(MemCategory category, size_t bytes)
+	{
+		if (isEnabled())
+			counters[category].live.fetch_sub((int64_t)bytes, std::memory_order_relaxed);
+	}
+
+	// Prints live and peak bytes and allocation counts per category
+	void report(std::ostream &out, const char *phase);
+}
+
+// Standard allocator that counts what it hands out towards a MemCategory
+template<typename T, MemCategory Category>
+struct CountingAllocator
+{
+	typedef T value_type;
+
+	template<typename U>
+	struct rebind
+	{
+		typedef CountingAllocator<U, Category> other;
+	};
+
+	CountingAllocator() = default;
+
+	template<typename U>
+	CountingAllocator(const CountingAllocator<U, Category>&)
+	{
+	}
+
+	T* allocate(size_t n)
+	{
+		MemStats::allocate(Category, n * sizeof(T));
+		return std::allocator<T>().allocate(n);
+	}
+
+	void deallocate(T *p, size_t n)
+	{
+		MemStats::release(Category, n * sizeof(T));
+		std::allocator<T>().deallocate(p, n);
+	}
+
+	template<typename U>
+	bool operator==(const CountingAllocator<U, Category>&) const
+	{
+		return true;
+	}
+
+	template<typename U>
+	bool operator!=(const CountingAllocator<U, Category>&) const
+	{
+		return false;
+	}
+};
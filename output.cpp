@@ -0,0 +1,431 @@
+#include "output.h"
+#include "split.h"
+#include "reach.h"
+#include "export.h"
+#include "search.h"
+#include "tar.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#include <experimental/filesystem>
+
+namespace filesystem = std::experimental::filesystem;
+
+// Buffer size for amalgamated files, so they're written in large sequential chunks
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+
+// Rendered files waiting to be written, per renderer thread
+#define OUTPUT_QUEUE_DEPTH 4
+
+// Hands rendered files from the renderer threads to the writer in a fixed
+// order. A renderer blocks while its file is more than `capacity` places ahead
+// of the writer, so only a bounded number of rendered files is held in memory.
+class RenderQueue
+{
+public:
+	RenderQueue(size_t count, size_t capacity) : m_slots(count), m_ready(count, false), m_next(0), m_capacity(capacity), m_cancelled(false)
+	{
+	}
+
+	void push(size_t position, std::string &&rendered)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		m_cv.wait(lock, [&]() { return position < m_next + m_capacity || m_cancelled; });
+
+		if (m_cancelled)
+			return;
+
+		MemStats::allocate(MEM_RENDERED, rendered.capacity());
+		m_slots[position] = std::move(rendered);
+		m_ready[position] = true;
+
+		m_cv.notify_all();
+	}
+
+	// Returns false once the queue is cancelled
+	bool pop(std::string &rendered)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		m_cv.wait(lock, [&]() { return m_ready[m_next] || m_cancelled; });
+
+		if (m_cancelled)
+			return false;
+
+		rendered.clear();
+		rendered.swap(m_slots[m_next]);
+		m_next++;
+
+		MemStats::release(MEM_RENDERED, rendered.capacity());
+
+		m_cv.notify_all();
+
+		return true;
+	}
+
+	// Stops the writer and any blocked renderers, when a file will never come
+	void cancel()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_cancelled = true;
+		m_cv.notify_all();
+	}
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::vector<std::string> m_slots;
+	std::vector<bool> m_ready;
+	size_t m_next;
+	size_t m_capacity;
+	bool m_cancelled;
+};
+
+static filesystem::path getRelativePath(Cpp::File *cpp)
+{
+	std::string filename = cpp->filename;
+
+	size_t pos;
+	while ((pos = filename.find("\\")) != std::string::npos)
+	{
+		filename.replace(pos, 1, "/");
+	}
+
+	return filesystem::path(filename).relative_path();
+}
+
+static void writeDirectory(std::vector<Cpp::File*> &files, const std::vector<size_t> &order, RenderQueue &queue, const char *outDirectory)
+{
+	std::string rendered;
+
+	for (size_t i : order)
+	{
+		if (!queue.pop(rendered))
+			return;
+
+		filesystem::path path(outDirectory);
+
+		path /= getRelativePath(files[i]);
+		path = path.make_preferred();
+
+		filesystem::create_directories(path.parent_path());
+
+		std::cout << "Writing file " << path << "..." << std::endl;
+
+		TraceSpan span("Write file");
+		span.arg("path", path.string());
+		span.arg("bytes", rendered.size());
+
+		std::ofstream file(path);
+		file.write(rendered.data(), rendered.size());
+		file.close();
+	}
+}
+
+// Writes the next count files from the queue one after another into a single
+// file, each preceded by a marker comment with its compile unit path.
+static void writeAmalgamated(const filesystem::path &path, std::vector<Cpp::File*> &files, const size_t *order, size_t count, RenderQueue &queue)
+{
+	if (path.has_parent_path())
+		filesystem::create_directories(path.parent_path());
+
+	std::cout << "Writing file " << path << "..." << std::endl;
+
+	std::unique_ptr<char[]> buffer(new char[OUTPUT_BUFFER_SIZE]);
+	std::ofstream file;
+	file.rdbuf()->pubsetbuf(buffer.get(), OUTPUT_BUFFER_SIZE);
+	file.open(path, std::ios::binary);
+
+	std::string rendered;
+
+	for (size_t n = 0; n < count && queue.pop(rendered); n++)
+	{
+		TraceSpan span("Write compile unit");
+		span.arg("cu", files[order[n]]->filename);
+		span.arg("bytes", rendered.size());
+
+		file << "/*\n * Compile unit: " << files[order[n]]->filename << "\n */\n\n";
+		file << rendered << "\n";
+	}
+
+	file.close();
+}
+
+// The compile unit path with forward slashes and without a drive or leading slash
+static std::string getArchiveName(Cpp::File *cpp)
+{
+	std::string name = cpp->filename;
+	std::replace(name.begin(), name.end(), '\\', '/');
+
+	if (name.size() >= 2 && name[1] == ':')
+		name.erase(0, 2);
+
+	name.erase(0, name.find_first_not_of('/'));
+
+	return name;
+}
+
+// Writes every file from the queue into one tar archive, in the order of the
+// compile units. Nothing but the archive itself is created.
+static void writeArchive(std::vector<Cpp::File*> &files, const std::vector<size_t> &order, RenderQueue &queue, const char *filename, bool compress)
+{
+	std::cout << "Writing archive " << filename << "..." << std::endl;
+
+	TarWriter archive;
+	bool opened = archive.open(filename, compress);
+
+	if (!opened)
+		std::cout << "Failed to open " << filename << " for writing." << std::endl;
+
+	std::string rendered;
+
+	// Keeps taking files so the renderers never block on a full queue
+	for (size_t i : order)
+	{
+		if (!queue.pop(rendered))
+			break;
+
+		if (!opened)
+			continue;
+
+		TraceSpan span("Write archive entry");
+		span.arg("cu", files[i]->filename);
+		span.arg("bytes", rendered.size());
+
+		archive.addFile(getArchiveName(files[i]), rendered.data(), rendered.size());
+	}
+
+	if (opened && !archive.close())
+		std::cout << "Failed to write " << filename << "." << std::endl;
+}
+
+// Groups files by the first directory below the directory all of them share
+static std::map<std::string, std::vector<size_t>> groupByDirectory(std::vector<Cpp::File*> &files)
+{
+	std::vector<std::vector<std::string>> components(files.size());
+	size_t common = SIZE_MAX;
+
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		for (const filesystem::path &part : getRelativePath(files[i]).parent_path())
+			components[i].push_back(part.string());
+
+		if (i == 0)
+			common = components[0].size();
+
+		size_t n = 0;
+		while (n < common && n < components[i].size() && components[i][n] == components[0][n])
+			n++;
+
+		common = n;
+	}
+
+	std::map<std::string, std::vector<size_t>> groups;
+
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		std::string group;
+
+		if (components[i].size() > common)
+			group = components[i][common];
+		else if (common > 0)
+			group = components[i][common - 1];
+		else
+			group = "root";
+
+		groups[group].push_back(i);
+	}
+
+	return groups;
+}
+
+// Renders files on jobs threads while the calling thread writes them. With a
+// feed, each file is rendered once the feed has it. Returns false if the
+// feed was cancelled.
+static bool renderAndWrite(std::vector<Cpp::File*> &files, const char *output, int jobs, const OutputOptions &options, FileFeed *feed)
+{
+	// The order files are written in. Renderers follow it too, so the writer
+	// never waits on a file that nobody has started rendering.
+	std::vector<size_t> order;
+	std::map<std::string, std::vector<size_t>> groups;
+
+	if (options.mode == OutputOptions::AMALGAMATED_PER_DIRECTORY)
+	{
+		groups = groupByDirectory(files);
+
+		for (auto &x : groups)
+			order.insert(order.end(), x.second.begin(), x.second.end());
+	}
+	else
+	{
+		for (size_t i = 0; i < files.size(); i++)
+			order.push_back(i);
+	}
+
+	RenderQueue queue(files.size(), (size_t)jobs * OUTPUT_QUEUE_DEPTH);
+	std::atomic<size_t> next(0);
+	std::atomic<bool> cancelled(false);
+
+	auto render = [&]()
+	{
+		size_t n;
+
+		while ((n = next++) < order.size())
+		{
+			Cpp::File *file = feed ? feed->wait(order[n]) : files[order[n]];
+
+			if (!file)
+			{
+				cancelled = true;
+				queue.cancel();
+				return;
+			}
+
+			TraceSpan span("File::toString");
+			span.arg("cu", file->filename);
+
+			std::string rendered = file->toString(options.justUserTypes, false);
+
+			span.arg("bytes", rendered.size());
+			span.end();
+
+			queue.push(n, std::move(rendered));
+		}
+	};
+
+	// Rendering continues on these threads while this one writes
+	std::vector<std::thread> threads;
+
+	for (int i = 0; i < jobs; i++)
+		threads.emplace_back(render);
+
+	switch (options.mode)
+	{
+	case OutputOptions::DIRECTORY:
+		writeDirectory(files, order, queue, output);
+		break;
+	case OutputOptions::AMALGAMATED:
+		writeAmalgamated(filesystem::path(output), files, order.data(), order.size(), queue);
+		break;
+	case OutputOptions::ARCHIVE:
+		writeArchive(files, order, queue, output, options.compress);
+		break;
+	case OutputOptions::AMALGAMATED_PER_DIRECTORY:
+	{
+		size_t start = 0;
+
+		for (auto &x : groups)
+		{
+			filesystem::path path(output);
+			path /= x.first + ".cpp";
+
+			writeAmalgamated(path.make_preferred(), files, order.data() + start, x.second.size(), queue);
+			start += x.second.size();
+		}
+
+		break;
+	}
+	case OutputOptions::SPLIT_TYPES:
+	case OutputOptions::REACHABLE:
+		// Written without rendering whole files, see writeCppFiles
+		break;
+	}
+
+	for (std::thread &thread : threads)
+		thread.join();
+
+	return !cancelled;
+}
+
+void writeCppFiles(std::vector<Cpp::File*> &files, const char *output, int jobs, const OutputOptions &options)
+{
+	if (options.exportFilename)
+		writeExport(files, options.exportFilename);
+
+	if (options.indexFilename)
+		writeNameIndex(files, options.indexFilename);
+
+	if (options.mode == OutputOptions::SPLIT_TYPES)
+	{
+		writeTypeHeaders(files, output);
+		return;
+	}
+
+	if (options.mode == OutputOptions::REACHABLE)
+	{
+		writeReachableTypes(files, output, options.roots);
+		return;
+	}
+
+	renderAndWrite(files, output, jobs, options, nullptr);
+}
+
+void FileFeed::push(size_t position, Cpp::File *file)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_files[position] = file;
+	m_cv.notify_all();
+}
+
+void FileFeed::cancel()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_cancelled = true;
+	m_cv.notify_all();
+}
+
+Cpp::File* FileFeed::wait(size_t position)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_cv.wait(lock, [&]() { return m_files[position] || m_cancelled; });
+
+	return m_cancelled ? nullptr : m_files[position];
+}
+
+bool writeCppFiles(FileFeed &feed, const char *output, int jobs, const OutputOptions &options)
+{
+	std::vector<Cpp::File*> &files = feed.getFiles();
+
+	bool streamed = options.mode == OutputOptions::DIRECTORY ||
+		options.mode == OutputOptions::AMALGAMATED ||
+		options.mode == OutputOptions::ARCHIVE;
+
+	if (!streamed)
+	{
+		for (size_t i = 0; i < files.size(); i++)
+		{
+			if (!feed.wait(i))
+				return false;
+		}
+
+		writeCppFiles(files, output, jobs, options);
+		return true;
+	}
+
+	if (!renderAndWrite(files, output, jobs, options, &feed))
+		return false;
+
+	// These need every file, so they come last
+	if (options.exportFilename)
+		writeExport(files, options.exportFilename);
+
+	if (options.indexFilename)
+		writeNameIndex(files, options.indexFilename);
+
+	return true;
+}
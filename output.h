@@ -0,0 +1,88 @@
+#pragma once
+
+#include "cpp.h"
+#include "filter.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct OutputOptions
+{
+	enum Mode
+	{
+		// One file per compile unit, mirroring the compile unit paths
+		DIRECTORY,
+		// Every compile unit in one file
+		AMALGAMATED,
+		// One file per top-level directory of the compile unit paths
+		AMALGAMATED_PER_DIRECTORY,
+		// One header per user type, see TypeHeaderGraph
+		SPLIT_TYPES,
+		// Every compile unit as a file in one tar archive, see TarWriter
+		ARCHIVE,
+		// Only the types reachable from roots, in one file, see ReachableTypeSet
+		REACHABLE
+	};
+
+	Mode mode = DIRECTORY;
+	bool justUserTypes = false;
+
+	// Gzip compresses the archive in ARCHIVE mode
+	bool compress = false;
+
+	// Root types and functions in REACHABLE mode
+	NameFilter roots;
+
+	// Also writes the binary export (see export.h) here, if set
+	const char *exportFilename = nullptr;
+
+	// Also writes the name search index (see search.h) here, if set
+	const char *indexFilename = nullptr;
+};
+
+// Renders every file on jobs threads while the calling thread writes the
+// rendered files to output as they become ready. output is a directory,
+// except in AMALGAMATED, ARCHIVE and REACHABLE mode where it's the path of the single
+// output file.
+void writeCppFiles(std::vector<Cpp::File*> &files, const char *output, int jobs, const OutputOptions &options = OutputOptions());
+
+// Hands files to writeCppFiles while they're still being converted. Each file
+// has a fixed position, which is the order files are written in, and files
+// are pushed in any order once they're complete.
+class FileFeed
+{
+public:
+	FileFeed(size_t count) : m_files(count, nullptr), m_cancelled(false)
+	{
+	}
+
+	void push(size_t position, Cpp::File *file);
+
+	// Gives up on the files that weren't pushed, for when conversion fails
+	void cancel();
+
+	// Blocks until the file at position is pushed. Returns nullptr if the feed
+	// is cancelled.
+	Cpp::File* wait(size_t position);
+
+	// Every position, with nullptr for the files that weren't pushed yet.
+	// Only read a position after waiting for it.
+	inline std::vector<Cpp::File*>& getFiles()
+	{
+		return m_files;
+	}
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::vector<Cpp::File*> m_files;
+	bool m_cancelled;
+};
+
+// Like writeCppFiles above, but renders and writes each file as soon as feed
+// has it. Output that needs every file first, like SPLIT_TYPES, the binary
+// export and the name index, waits for the rest. Returns false if the feed is
+// cancelled, in which case the files written so far are left as they are.
+bool writeCppFiles(FileFeed &feed, const char *output, int jobs, const OutputOptions &options = OutputOptions());
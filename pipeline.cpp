@@ -0,0 +1,262 @@
+#include "pipeline.h"
+#include "convert.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+// Parsed compile units waiting to be converted, per renderer thread
+#define PIPELINE_QUEUE_DEPTH 4
+
+// Hands parsed compile units, as the index of their entry, from the parser to
+// the converter. The parser blocks while it's `capacity` compile units ahead,
+// unless the converter waits for an entry it hasn't parsed yet.
+class UnitQueue
+{
+public:
+	UnitQueue(size_t capacity) : m_capacity(capacity), m_closed(false), m_waiting(false)
+	{
+	}
+
+	// Returns false if the queue was closed, so nothing more is wanted
+	bool push(int unit)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		m_cv.wait(lock, [&]() { return m_units.size() < m_capacity || m_closed || m_waiting; });
+
+		if (m_closed)
+			return false;
+
+		m_units.push_back(unit);
+		m_cv.notify_all();
+
+		return true;
+	}
+
+	// Returns false once the queue is closed and empty
+	bool pop(int *unit)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		m_cv.wait(lock, [&]() { return !m_units.empty() || m_closed; });
+
+		if (m_units.empty())
+			return false;
+
+		*unit = m_units.front();
+		m_units.pop_front();
+		m_cv.notify_all();
+
+		return true;
+	}
+
+	// Called by the parser when it's done, or by the converter when it gives up
+	void close()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_closed = true;
+		m_cv.notify_all();
+	}
+
+	// The converter's Dwarf::ParseWaiter, for references into compile units
+	// that aren't parsed yet. The parser notifies after each compile unit
+	// when it pushes it.
+	void waitForEntry(Dwarf *dwarf, int index)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		m_waiting = true;
+		m_cv.notify_all();
+		m_cv.wait(lock, [&]() { return dwarf->isParsed(index) || m_closed; });
+		m_waiting = false;
+	}
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::deque<int> m_units;
+	size_t m_capacity;
+	bool m_closed;
+	bool m_waiting;
+};
+
+int runPipeline(const char *elfFilename, const char *output, int jobs, const OutputOptions &options)
+{
+	std::cout << "Loading ELF file " << elfFilename << "..." << std::endl;
+
+	TraceSpan loadSpan("Load ELF");
+	ElfFile *elf = new ElfFile(elfFilename);
+	loadSpan.arg("bytes", elf->getFileSize());
+	loadSpan.end();
+
+	if (elf->getError())
+	{
+		std::cout << "Failed to parse " << elfFilename << " as an ELF file. Error Code: " << elf->getError() << std::endl;
+		return 1;
+	}
+
+	std::cout << "Loading DWARFv1 information..." << std::endl;
+
+	// Only finds where the entries are, they're parsed below
+	Dwarf *dwarf = new Dwarf(elf, usedAttributes, getCompileUnitFilter(), false);
+
+	if (dwarf->getError())
+	{
+		std::cout << "Failed to parse DWARF data. Error Code: " << dwarf->getError() << std::endl;
+		return 1;
+	}
+
+	SymbolTable symbols(elf);
+
+	// Files are numbered in the order of their first compile unit, as in
+	// cppFiles, and are complete once their last compile unit is converted
+	std::vector<int> unitEntries;
+	std::vector<size_t> unitFiles;
+	std::vector<int> unitsLeft;
+	std::unordered_map<std::string, size_t> filesByName;
+
+	for (int i = dwarf->findTag(DW_TAG_compile_unit, 0); i < dwarf->numEntries; i = dwarf->findTag(DW_TAG_compile_unit, i + 1))
+	{
+		Dwarf::Entry header;
+		Dwarf::Attribute *name = nullptr;
+
+		if (dwarf->peekEntry(dwarf->entries[i].offset, &header))
+			name = header.get(DW_AT_name);
+
+		size_t file = unitsLeft.size();
+
+		if (name)
+			file = filesByName.emplace(std::string(name->getString(), name->getStringLength()), file).first->second;
+
+		if (file == unitsLeft.size())
+			unitsLeft.push_back(0);
+
+		unitsLeft[file]++;
+		unitFiles.push_back(file);
+		unitEntries.push_back(i);
+	}
+
+	// A file can't be written while a later compile unit can still add methods
+	// to its classes. This is the last compile unit that can for each file,
+	// apart from the mangled names that are checked once the file is complete.
+	LateMethods late = findLateMethods(dwarf, unitEntries);
+	std::vector<size_t> lastMethodUnits(unitsLeft.size(), 0);
+
+	for (size_t i = 0; i < unitFiles.size(); i++)
+		lastMethodUnits[unitFiles[i]] = std::max(lastMethodUnits[unitFiles[i]], late.lastByTarget[i]);
+
+	std::cout << "Converting DWARFv1 entries to C++ data and writing " << unitsLeft.size() << " files..." << std::endl;
+
+	UnitQueue units((size_t)jobs * PIPELINE_QUEUE_DEPTH);
+	dwarf->setParseWaiter([&](int index) { units.waitForEntry(dwarf, index); });
+	FileFeed feed(unitsLeft.size());
+	bool parsed = false;
+	bool converted = false;
+
+	std::thread parser([&]()
+	{
+		TraceSpan span("Parse DWARF");
+		span.arg("entries", dwarf->numEntries);
+		span.arg("bytes", dwarf->getSectionSize());
+
+		int unit;
+
+		while ((unit = dwarf->parseCompileUnit()) >= 0 && units.push(unit));
+
+		parsed = !dwarf->getError();
+		units.close();
+	});
+
+	std::thread converter([&]()
+	{
+		size_t n = 0;
+		int unit;
+
+		// Complete files that wait for the compile unit in lastMethodUnits
+		std::vector<std::pair<size_t, Cpp::File*>> held;
+
+		while (units.pop(&unit))
+		{
+			Cpp::File *cpp = convertCompileUnit(&dwarf->entries[unit]);
+
+			if (!cpp || n >= unitFiles.size())
+			{
+				units.close();
+				break;
+			}
+
+			size_t file = unitFiles[n];
+
+			if (--unitsLeft[file] == 0)
+			{
+				for (Cpp::UserType *ut : cpp->userTypes)
+				{
+					auto it = late.lastByClassName.find(ut->name);
+
+					if (it != late.lastByClassName.end())
+						lastMethodUnits[file] = std::max(lastMethodUnits[file], it->second);
+				}
+
+				held.push_back({ file, cpp });
+			}
+
+			for (auto it = held.begin(); it != held.end();)
+			{
+				if (lastMethodUnits[it->first] > n)
+				{
+					++it;
+					continue;
+				}
+
+				std::vector<Cpp::File*> done(1, it->second);
+				applySymbolTable(done, symbols, !elf->isRelocatable());
+
+				feed.push(it->first, it->second);
+				it = held.erase(it);
+			}
+
+			n++;
+		}
+
+		converted = (n == unitFiles.size());
+
+		// Files that will never be complete would hold up the writer
+		if (!converted)
+			feed.cancel();
+
+		takeConvertedFiles();
+	});
+
+	bool written = writeCppFiles(feed, output, jobs, options);
+
+	parser.join();
+	converter.join();
+
+	// The waiter refers to the queue
+	dwarf->setParseWaiter(nullptr);
+
+	if (!parsed)
+	{
+		std::cout << "Failed to parse DWARF data. Error Code: " << dwarf->getError() << std::endl;
+		return 1;
+	}
+
+	if (!converted || !written)
+	{
+		std::cout << "Failed to process DWARF data." << std::endl;
+		return 1;
+	}
+
+	MemStats::report(std::cout, "at the end of the run");
+
+	std::cout << "Done." << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "output.h"
+
+// Converts an ELF file and writes the output with every stage running at once.
+// One thread parses the DWARF data a compile unit at a time. Another converts
+// each compile unit as soon as it's parsed. jobs threads render each file
+// once its last compile unit is converted, and any later one that adds methods
+// to its classes, and the calling thread writes the rendered files in order. The stages are connected by bounded queues, so the
+// first files are written long before the last compile unit is parsed, and
+// the total time approaches that of the slowest stage.
+int runPipeline(const char *elfFilename, const char *output, int jobs, const OutputOptions &options = OutputOptions());
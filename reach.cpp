@@ -0,0 +1,161 @@
+#include "reach.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+ReachableTypeSet::ReachableTypeSet(std::vector<Cpp::File*> &files, const NameFilter &roots)
+{
+	size_t count = 0;
+
+	for (Cpp::File *file : files)
+		count += file->userTypes.size();
+
+	m_byType.reserve(count);
+
+	for (Cpp::File *file : files)
+	{
+		for (Cpp::UserType *ut : file->userTypes)
+		{
+			if (roots.matches(ut->name))
+				getNode(ut);
+		}
+
+		for (Cpp::Function &fun : file->functions)
+		{
+			if (roots.matches(fun.name) || (!fun.mangledName.empty() && roots.matches(fun.mangledName)))
+				addFunction(fun);
+		}
+	}
+
+	// Each node is followed once, so this stays linear in the reached types
+	while (!m_pending.empty())
+	{
+		ReachableType *node = m_pending.back();
+		m_pending.pop_back();
+
+		addDependencies(node);
+	}
+}
+
+ReachableType* ReachableTypeSet::getNode(Cpp::UserType *ut)
+{
+	auto it = m_byType.find(ut);
+
+	if (it != m_byType.end())
+		return it->second;
+
+	auto named = m_byName.find(ut->name);
+
+	// Named types are the same type in every compile unit, so only the first
+	// one reached is written
+	if (named != m_byName.end() && !ut->anonymous)
+	{
+		m_byType[ut] = named->second;
+		return named->second;
+	}
+
+	std::string name = ut->name;
+
+	// Generated names are only unique within a compile unit
+	if (named != m_byName.end())
+	{
+		for (int i = 1; m_byName.count(name); i++)
+			name = ut->name + "_" + std::to_string(i);
+
+		m_names[ut] = name;
+	}
+
+	ReachableType *node = new ReachableType();
+	node->type = ut;
+
+	m_nodes.emplace_back(node);
+	m_byType[ut] = node;
+	m_byName[name] = node;
+	m_pending.push_back(node);
+
+	return node;
+}
+
+void ReachableTypeSet::addFunction(Cpp::Function &fun)
+{
+	addDependency(nullptr, fun.returnType, false);
+
+	for (Cpp::FunctionType::Parameter &p : fun.parameters)
+		addDependency(nullptr, p.type, false);
+
+	for (Cpp::Variable &var : fun.variables)
+		addDependency(nullptr, var.type, false);
+}
+
+bool ReachableTypeSet::write(const char *filename)
+{
+	std::vector<ReachableType*> order;
+	order.reserve(m_nodes.size());
+
+	for (std::unique_ptr<ReachableType> &node : m_nodes)
+		sort(node.get(), order);
+
+	std::cout << "Writing " << order.size() << " reachable types to " << filename << "..." << std::endl;
+
+	// Types that share a generated name are written under their new names, and
+	// given their own ones back afterwards, so the files aren't changed
+	swapNames();
+
+	std::stringstream ss;
+	ss << "#pragma once\n\n";
+
+	for (ReachableType *node : order)
+	{
+		if (isClassType(node->type))
+			ss << node->type->toDeclarationString() << "\n";
+	}
+
+	ss << "\n";
+
+	for (ReachableType *node : order)
+	{
+		Cpp::UserType *ut = node->type;
+
+		if (ut->type == Cpp::UserType::ARRAY || ut->type == Cpp::UserType::FUNCTION)
+			ss << ut->toDeclarationString() << "\n\n";
+		else
+			ss << ut->toDefinitionString(false) << "\n\n";
+	}
+
+	std::string str = ss.str();
+
+	swapNames();
+
+	std::ofstream file(filename, std::ios::binary);
+
+	if (!file.is_open())
+	{
+		std::cout << "Failed to open " << filename << " for writing." << std::endl;
+		return false;
+	}
+
+	file.write(str.data(), str.size());
+
+	if (!file)
+	{
+		std::cout << "Failed to write " << filename << "." << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool writeReachableTypes(std::vector<Cpp::File*> &files, const char *filename, const NameFilter &roots)
+{
+	ReachableTypeSet set(files, roots);
+
+	if (set.size() == 0)
+	{
+		std::cout << "No types are reachable from the given roots." << std::endl;
+		return false;
+	}
+
+	return set.write(filename);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "cpp.h"
+#include "filter.h"
+#include "typegraph.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+struct ReachableType : TypeGraphNode<ReachableType>
+{
+};
+
+// Finds the user types reachable from a set of root types and functions, and
+// writes only those to one file. Types are reached through members, base
+// classes, the signatures of methods, array elements and function types, and
+// from a root function through its signature and local variables.
+//
+// Definitions come after the definitions of the types they need complete
+// (base classes, members and array elements held by value, enums and
+// typedefs). Classes that are only used through pointers or references are
+// covered by forward declarations at the top of the file. Types with the
+// same name in different compile units are written once.
+class ReachableTypeSet : public TypeGraph<ReachableType>
+{
+public:
+	// Roots are user types matching roots by name, and functions matching
+	// it by name or mangled name
+	ReachableTypeSet(std::vector<Cpp::File*> &files, const NameFilter &roots);
+
+	size_t size() const
+	{
+		return m_nodes.size();
+	}
+
+	bool write(const char *filename);
+
+protected:
+	ReachableType* getNode(Cpp::UserType *ut) override;
+
+private:
+	// Nodes whose dependencies haven't been followed yet
+	std::vector<ReachableType*> m_pending;
+
+	void addFunction(Cpp::Function &fun);
+};
+
+// Returns false if no type was reached or the file couldn't be written
+bool writeReachableTypes(std::vector<Cpp::File*> &files, const char *filename, const NameFilter &roots);
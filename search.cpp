@@ -0,0 +1,453 @@
+#include "search.h"
+#include "convert.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+struct NameIndexHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t itemCount;
+	uint32_t trigramCount;
+	uint32_t postingCount;
+	uint32_t stringSize;
+};
+
+// Fuzzy matches need at least this share of trigrams in common with the query
+#define FUZZY_THRESHOLD 0.4f
+
+static inline bool isLittleEndian()
+{
+	const uint16_t one = 1;
+	return *(const char*)&one == 1;
+}
+
+static inline void swapWords(char *data, size_t size)
+{
+	for (size_t i = 0; i < size; i += 4)
+	{
+		std::swap(data[i], data[i + 3]);
+		std::swap(data[i + 1], data[i + 2]);
+	}
+}
+
+// Writes an array of structs made of 32-bit words in little-endian order
+template<typename T>
+static void writeWords(std::ofstream &file, const T *data, size_t count)
+{
+	static_assert(sizeof(T) % 4 == 0, "Index tables must be made of 32-bit words.");
+
+	size_t size = count * sizeof(T);
+
+	if (isLittleEndian())
+	{
+		file.write((const char*)data, size);
+		return;
+	}
+
+	std::vector<char> swapped((const char*)data, (const char*)data + size);
+	swapWords(swapped.data(), size);
+	file.write(swapped.data(), size);
+}
+
+template<typename T>
+static bool readWords(std::ifstream &file, T *data, size_t count)
+{
+	size_t size = count * sizeof(T);
+
+	if (!file.read((char*)data, size))
+		return false;
+
+	if (!isLittleEndian())
+		swapWords((char*)data, size);
+
+	return true;
+}
+
+static inline std::string toLower(const char *str, size_t length)
+{
+	std::string lower(str, length);
+
+	for (char &c : lower)
+		c = (char)tolower((unsigned char)c);
+
+	return lower;
+}
+
+static inline uint32_t trigramKey(const char *lower)
+{
+	return ((uint32_t)(unsigned char)lower[0] << 16) | ((uint32_t)(unsigned char)lower[1] << 8) | (unsigned char)lower[2];
+}
+
+// The distinct trigrams of an already lowercased string, sorted
+static std::vector<uint32_t> getTrigrams(const std::string &lower)
+{
+	std::vector<uint32_t> keys;
+
+	for (size_t i = 0; i + 3 <= lower.size(); i++)
+		keys.push_back(trigramKey(lower.data() + i));
+
+	std::sort(keys.begin(), keys.end());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+	return keys;
+}
+
+NameIndex::NameIndex()
+{
+	m_strings.push_back('\0');
+}
+
+NameIndex::NameIndex(std::vector<Cpp::File*> &files) : NameIndex()
+{
+	for (Cpp::File *cpp : files)
+	{
+		uint32_t file = addString(cpp->filename);
+
+		for (Cpp::UserType *ut : cpp->userTypes)
+		{
+			uint32_t owner = addString(ut->name);
+
+			addItem(ut->name, 0, file, KIND_TYPE, addString(ut->toKindString()), 0);
+
+			if (ut->type != Cpp::UserType::CLASS && ut->type != Cpp::UserType::STRUCT && ut->type != Cpp::UserType::UNION)
+				continue;
+
+			for (Cpp::ClassType::Member &m : ut->classData->members)
+			{
+				if (!m.name.empty())
+					addItem(m.name, owner, file, KIND_MEMBER, m.offset, 0);
+			}
+		}
+
+		for (Cpp::Variable &var : cpp->variables)
+			addItem(var.name, 0, file, KIND_VARIABLE, 0, var.address);
+
+		for (Cpp::Function &fun : cpp->functions)
+		{
+			uint32_t owner = fun.typeOwner ? addString(fun.typeOwner->name) : 0;
+
+			addItem(fun.name, owner, file, KIND_FUNCTION, 0, fun.startAddress);
+		}
+	}
+
+	std::unordered_map<std::string, uint32_t>().swap(m_stringOffsets);
+
+	buildTrigrams();
+}
+
+void NameIndex::addItem(const std::string &name, uint32_t owner, uint32_t file, Kind kind, uint32_t detail, uint32_t address)
+{
+	Item item = { addString(name), owner, file, (uint32_t)kind, detail, address };
+	m_items.push_back(item);
+}
+
+uint32_t NameIndex::addString(const std::string &str)
+{
+	auto it = m_stringOffsets.find(str);
+
+	if (it != m_stringOffsets.end())
+		return it->second;
+
+	uint32_t offset = (uint32_t)m_strings.size();
+	m_strings.insert(m_strings.end(), str.begin(), str.end());
+	m_strings.push_back('\0');
+	m_stringOffsets[str] = offset;
+
+	return offset;
+}
+
+void NameIndex::buildTrigrams()
+{
+	std::vector<std::pair<uint32_t, uint32_t>> pairs;
+
+	for (uint32_t i = 0; i < m_items.size(); i++)
+	{
+		const char *name = getString(m_items[i].name);
+
+		for (uint32_t key : getTrigrams(toLower(name, strlen(name))))
+			pairs.push_back(std::make_pair(key, i));
+	}
+
+	std::sort(pairs.begin(), pairs.end());
+
+	m_postings.reserve(pairs.size());
+
+	for (const std::pair<uint32_t, uint32_t> &pair : pairs)
+	{
+		if (m_trigrams.empty() || m_trigrams.back().key != pair.first)
+			m_trigrams.push_back({ pair.first, (uint32_t)m_postings.size(), 0 });
+
+		m_trigrams.back().postingCount++;
+		m_postings.push_back(pair.second);
+	}
+}
+
+const NameIndex::Trigram* NameIndex::findTrigram(uint32_t key) const
+{
+	auto it = std::lower_bound(m_trigrams.begin(), m_trigrams.end(), key,
+		[](const Trigram &t, uint32_t k) { return t.key < k; });
+
+	if (it == m_trigrams.end() || it->key != key)
+		return nullptr;
+
+	return &*it;
+}
+
+std::vector<NameIndex::Match> NameIndex::search(const std::string &query, size_t limit) const
+{
+	std::vector<Match> matches;
+	std::string lowerQuery = toLower(query.data(), query.size());
+
+	if (query.empty())
+		return matches;
+
+	// Scores substring matches between 2 and 4, so they come before fuzzy ones
+	auto scoreSubstring = [&](const Item &item, const char *name, size_t length) -> bool
+	{
+		std::string lowerName = toLower(name, length);
+		size_t position = lowerName.find(lowerQuery);
+
+		if (position == std::string::npos)
+			return false;
+
+		float score;
+
+		if (length == query.size())
+			score = (query == name) ? 4.0f : 3.5f;
+		else if (position == 0)
+			score = 3.0f + (float)query.size() / length;
+		else
+			score = 2.0f + (float)query.size() / length;
+
+		matches.push_back({ &item, score, true });
+
+		return true;
+	};
+
+	std::vector<uint32_t> queryTrigrams = getTrigrams(lowerQuery);
+
+	if (queryTrigrams.empty())
+	{
+		for (const Item &item : m_items)
+		{
+			const char *name = getString(item.name);
+			scoreSubstring(item, name, strlen(name));
+		}
+	}
+	else
+	{
+		// How many of the query's trigrams each name has
+		std::vector<uint16_t> counts(m_items.size());
+		std::vector<uint32_t> touched;
+
+		for (uint32_t key : queryTrigrams)
+		{
+			const Trigram *trigram = findTrigram(key);
+
+			if (!trigram)
+				continue;
+
+			for (uint32_t i = 0; i < trigram->postingCount; i++)
+			{
+				uint32_t item = m_postings[trigram->firstPosting + i];
+
+				if (counts[item]++ == 0)
+					touched.push_back(item);
+			}
+		}
+
+		for (uint32_t i : touched)
+		{
+			const Item &item = m_items[i];
+			const char *name = getString(item.name);
+			size_t length = strlen(name);
+
+			if (counts[i] == queryTrigrams.size() && scoreSubstring(item, name, length))
+				continue;
+
+			// Dice coefficient of the two trigram sets
+			size_t nameTrigrams = length >= 3 ? length - 2 : 1;
+			float similarity = 2.0f * counts[i] / (queryTrigrams.size() + nameTrigrams);
+
+			if (similarity >= FUZZY_THRESHOLD)
+				matches.push_back({ &item, std::min(similarity, 1.0f), false });
+		}
+	}
+
+	auto better = [this](const Match &a, const Match &b)
+	{
+		if (a.score != b.score)
+			return a.score > b.score;
+
+		int order = strcmp(getString(a.item->name), getString(b.item->name));
+
+		if (order != 0)
+			return order < 0;
+
+		return a.item < b.item;
+	};
+
+	if (matches.size() > limit)
+	{
+		std::partial_sort(matches.begin(), matches.begin() + limit, matches.end(), better);
+		matches.resize(limit);
+	}
+	else
+		std::sort(matches.begin(), matches.end(), better);
+
+	return matches;
+}
+
+const char* NameIndex::kindToString(Kind kind)
+{
+	switch (kind)
+	{
+	case KIND_TYPE:
+		return "type";
+	case KIND_MEMBER:
+		return "member";
+	case KIND_FUNCTION:
+		return "function";
+	case KIND_VARIABLE:
+		return "variable";
+	}
+
+	return "unknown";
+}
+
+bool NameIndex::save(const char *filename) const
+{
+	std::ofstream file(filename, std::ios::binary);
+
+	if (!file)
+		return false;
+
+	NameIndexHeader header = { NAME_INDEX_MAGIC, NAME_INDEX_VERSION,
+		(uint32_t)m_items.size(), (uint32_t)m_trigrams.size(), (uint32_t)m_postings.size(), (uint32_t)m_strings.size() };
+
+	writeWords(file, &header, 1);
+	writeWords(file, m_items.data(), m_items.size());
+	writeWords(file, m_trigrams.data(), m_trigrams.size());
+	writeWords(file, m_postings.data(), m_postings.size());
+	file.write(m_strings.data(), m_strings.size());
+
+	return file.good();
+}
+
+bool NameIndex::load(const char *filename)
+{
+	std::ifstream file(filename, std::ios::binary);
+	NameIndexHeader header;
+
+	if (!file || !readWords(file, &header, 1) ||
+		header.magic != NAME_INDEX_MAGIC || header.version != NAME_INDEX_VERSION || header.stringSize == 0)
+		return false;
+
+	m_items.resize(header.itemCount);
+	m_trigrams.resize(header.trigramCount);
+	m_postings.resize(header.postingCount);
+	m_strings.resize(header.stringSize);
+
+	if (!readWords(file, m_items.data(), m_items.size()) ||
+		!readWords(file, m_trigrams.data(), m_trigrams.size()) ||
+		!readWords(file, m_postings.data(), m_postings.size()) ||
+		!file.read(m_strings.data(), m_strings.size()) ||
+		m_strings.back() != '\0')
+		return false;
+
+	// Everything is indexed directly, so check it all once here
+	for (const Item &item : m_items)
+	{
+		if (item.name >= header.stringSize || item.owner >= header.stringSize ||
+			item.file >= header.stringSize || item.kind > KIND_VARIABLE ||
+			(item.kind == KIND_TYPE && item.detail >= header.stringSize))
+			return false;
+	}
+
+	for (const Trigram &trigram : m_trigrams)
+	{
+		if (trigram.firstPosting > header.postingCount || trigram.postingCount > header.postingCount - trigram.firstPosting)
+			return false;
+	}
+
+	for (uint32_t posting : m_postings)
+	{
+		if (posting >= header.itemCount)
+			return false;
+	}
+
+	return true;
+}
+
+bool NameIndex::isIndexFile(const char *filename)
+{
+	std::ifstream file(filename, std::ios::binary);
+	NameIndexHeader header;
+
+	return file && readWords(file, &header, 1) && header.magic == NAME_INDEX_MAGIC;
+}
+
+bool writeNameIndex(std::vector<Cpp::File*> &files, const char *filename)
+{
+	std::cout << "Writing name index " << filename << "..." << std::endl;
+
+	if (!NameIndex(files).save(filename))
+	{
+		std::cout << "Failed to write " << filename << "." << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+int runSearch(const char *query, const char *input, size_t limit)
+{
+	NameIndex index;
+
+	if (NameIndex::isIndexFile(input))
+	{
+		if (!index.load(input))
+		{
+			std::cout << "Failed to read the index " << input << "." << std::endl;
+			return 1;
+		}
+	}
+	else
+	{
+		if (!convertElfFile(input))
+			return 1;
+
+		std::vector<Cpp::File*> files = takeConvertedFiles();
+		index = NameIndex(files);
+	}
+
+	std::vector<NameIndex::Match> matches = index.search(query, limit);
+
+	std::cout << "Searched " << index.size() << " names, " << matches.size() << " matches for \"" << query << "\":" << std::endl;
+
+	for (const NameIndex::Match &match : matches)
+	{
+		const NameIndex::Item &item = *match.item;
+		std::string name = index.getString(item.name);
+
+		if (item.owner != 0)
+			name = std::string(index.getString(item.owner)) + "::" + name;
+
+		std::cout << std::fixed << std::setprecision(2) << match.score << "\t" <<
+			(item.kind == NameIndex::KIND_TYPE ? index.getString(item.detail) : NameIndex::kindToString((NameIndex::Kind)item.kind)) << "\t" <<
+			name << "\t" << index.getString(item.file);
+
+		if (item.address != 0)
+			std::cout << "\t" << std::hex << std::showbase << item.address << std::dec << std::noshowbase;
+
+		std::cout << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "cpp.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#define NAME_INDEX_MAGIC   0x49433244 // "D2CI"
+#define NAME_INDEX_VERSION 1
+
+// Trigram index over the names of every user type, member, function and
+// variable of a converted program, for substring and fuzzy name searches.
+//
+// Each name is split into the overlapping three character sequences of its
+// lowercased form. A search counts, for every name, how many of the query's
+// trigrams it shares, using the sorted list of names per trigram. Names with
+// all of them are checked for the query as a substring, and the rest are
+// ranked by how similar their trigrams are. Queries shorter than a trigram
+// are checked against every name.
+//
+// The index is saved as a header and three tables of 32-bit little-endian
+// words (items, trigrams, postings), followed by the string table.
+class NameIndex
+{
+public:
+	enum Kind
+	{
+		KIND_TYPE,
+		KIND_MEMBER,
+		KIND_FUNCTION,
+		KIND_VARIABLE
+	};
+
+	// A named thing. Strings are offsets into the string table.
+	struct Item
+	{
+		uint32_t name;
+		uint32_t owner; // Class of a member or method, otherwise the empty string
+		uint32_t file;
+		uint32_t kind;
+		uint32_t detail; // The type's kind ("struct", ...) or the member's offset
+		uint32_t address; // Functions and static variables, otherwise 0
+	};
+
+	struct Match
+	{
+		const Item *item;
+		float score;
+		bool substring;
+	};
+
+	NameIndex();
+	NameIndex(std::vector<Cpp::File*> &files);
+
+	// Ranked matches, best first. Substring matches always rank above fuzzy ones.
+	std::vector<Match> search(const std::string &query, size_t limit) const;
+
+	inline const char* getString(uint32_t offset) const
+	{
+		return m_strings.data() + offset;
+	}
+
+	inline size_t size() const
+	{
+		return m_items.size();
+	}
+
+	static const char* kindToString(Kind kind);
+
+	bool save(const char *filename) const;
+	bool load(const char *filename);
+
+	// Whether filename starts like a saved index
+	static bool isIndexFile(const char *filename);
+
+private:
+	struct Trigram
+	{
+		uint32_t key;
+		uint32_t firstPosting;
+		uint32_t postingCount;
+	};
+
+	std::vector<char> m_strings;
+	std::vector<Item> m_items;
+	std::vector<Trigram> m_trigrams;
+	std::vector<uint32_t> m_postings; // Item indices, ascending per trigram
+
+	// Only used while building
+	std::unordered_map<std::string, uint32_t> m_stringOffsets;
+
+	void addItem(const std::string &name, uint32_t owner, uint32_t file, Kind kind, uint32_t detail, uint32_t address);
+	uint32_t addString(const std::string &str);
+	void buildTrigrams();
+	const Trigram* findTrigram(uint32_t key) const;
+};
+
+// Builds the index for files and saves it to filename. Returns false if the file couldn't be written.
+bool writeNameIndex(std::vector<Cpp::File*> &files, const char *filename);
+
+// Searches the names in input, which is either an ELF file or a saved index,
+// and prints the best limit matches
+int runSearch(const char *query, const char *input, size_t limit);
@@ -0,0 +1,403 @@
+#include "server.h"
+
+#include <algorithm>
+
+QueryServer::QueryServer(std::vector<Cpp::File*> &files, const SymbolTable *symbols) : m_files(files), m_symbols(symbols), m_nameIndex(files)
+{
+	for (Cpp::File *cpp : m_files)
+	{
+		m_filesByName[cpp->filename] = cpp;
+
+		for (Cpp::UserType *ut : cpp->userTypes)
+			m_typesByName[ut->name].push_back({ cpp, ut });
+
+		for (Cpp::Function &fun : cpp->functions)
+		{
+			FunctionRef ref = { cpp, &fun };
+
+			m_functionsByName[fun.name].push_back(ref);
+
+			if (!fun.mangledName.empty() && fun.mangledName != fun.name)
+				m_functionsByName[fun.mangledName].push_back(ref);
+
+			if (fun.startAddress != 0)
+				m_functionsByAddress.push_back(ref);
+		}
+	}
+
+	std::sort(m_functionsByAddress.begin(), m_functionsByAddress.end(),
+		[](const FunctionRef &a, const FunctionRef &b) { return a.function->startAddress < b.function->startAddress; });
+}
+
+int QueryServer::run(std::istream &in, std::ostream &out)
+{
+	std::string line;
+
+	while (std::getline(in, line))
+	{
+		if (line.empty())
+			continue;
+
+		Json::Object request;
+
+		if (Json::parseObject(line, &request))
+		{
+			std::string cmd;
+
+			if (Json::getString(request, "cmd", &cmd) && cmd == "quit")
+				break;
+		}
+
+		out << handle(line) << "\n";
+		out.flush();
+	}
+
+	return 0;
+}
+
+std::string QueryServer::handle(const std::string &line)
+{
+	Json::Object request;
+	std::stringstream results;
+	std::stringstream response;
+	std::string cmd;
+	bool ok = false;
+
+	m_error.clear();
+
+	if (!Json::parseObject(line, &request))
+		m_error = "Malformed request.";
+	else if (!Json::getString(request, "cmd", &cmd))
+		m_error = "Missing \"cmd\".";
+	else if (cmd == "cus")
+		ok = queryCompileUnits(request, results);
+	else if (cmd == "type")
+		ok = queryType(request, results);
+	else if (cmd == "members")
+		ok = queryMembers(request, results);
+	else if (cmd == "function")
+		ok = queryFunction(request, results);
+	else if (cmd == "symbol")
+		ok = querySymbol(request, results);
+	else if (cmd == "search")
+		ok = querySearch(request, results);
+	else if (cmd == "render")
+		ok = queryRender(request, results);
+	else
+		m_error = "Unknown command '" + cmd + "'.";
+
+	response << "{";
+
+	auto id = request.find("id");
+	if (id != request.end())
+		response << "\"id\":" << (id->second.isString ? Json::escape(id->second.string) : id->second.string) << ",";
+
+	if (ok)
+		response << "\"ok\":true,\"results\":[" << results.str() << "]}";
+	else
+		response << "\"ok\":false,\"error\":" << Json::escape(m_error) << "}";
+
+	return response.str();
+}
+
+bool QueryServer::queryCompileUnits(const Json::Object &, std::stringstream &results)
+{
+	for (size_t i = 0; i < m_files.size(); i++)
+	{
+		Cpp::File *cpp = m_files[i];
+
+		if (i != 0)
+			results << ",";
+
+		results << "{\"cu\":" << Json::escape(cpp->filename) <<
+			",\"types\":" << cpp->userTypes.size() <<
+			",\"variables\":" << cpp->variables.size() <<
+			",\"functions\":" << cpp->functions.size() << "}";
+	}
+
+	return true;
+}
+
+bool QueryServer::queryType(const Json::Object &request, std::stringstream &results)
+{
+	std::string name;
+
+	if (!Json::getString(request, "name", &name))
+	{
+		m_error = "Missing \"name\".";
+		return false;
+	}
+
+	auto it = m_typesByName.find(name);
+
+	if (it == m_typesByName.end())
+		return true;
+
+	for (size_t i = 0; i < it->second.size(); i++)
+	{
+		if (i != 0)
+			results << ",";
+
+		results << typeToJson(it->second[i]);
+	}
+
+	return true;
+}
+
+bool QueryServer::queryMembers(const Json::Object &request, std::stringstream &results)
+{
+	std::string name;
+	uint64_t offset;
+
+	if (!Json::getString(request, "type", &name) || !Json::getUnsigned(request, "offset", &offset))
+	{
+		m_error = "Expected \"type\" and \"offset\".";
+		return false;
+	}
+
+	auto it = m_typesByName.find(name);
+
+	if (it == m_typesByName.end())
+		return true;
+
+	bool first = true;
+
+	for (const TypeRef &ref : it->second)
+	{
+		if (ref.type->type != Cpp::UserType::CLASS &&
+			ref.type->type != Cpp::UserType::STRUCT &&
+			ref.type->type != Cpp::UserType::UNION)
+			continue;
+
+		const Cpp::Layout &layout = ref.type->getLayout();
+		Cpp::Vector<Cpp::ClassType::Member> &members = ref.type->classData->members;
+
+		for (size_t i = 0; i < members.size(); i++)
+		{
+			Cpp::ClassType::Member &m = members[i];
+			int size = layout.members[i].size;
+
+			if (offset < (uint64_t)m.offset || offset >= (uint64_t)m.offset + (size > 0 ? size : 1))
+				continue;
+
+			if (!first)
+				results << ",";
+			first = false;
+
+			results << "{\"cu\":" << Json::escape(ref.file->filename) <<
+				",\"name\":" << Json::escape(m.name) <<
+				",\"offset\":" << m.offset <<
+				",\"size\":" << size <<
+				",\"declaration\":" << Json::escape(m.toString(false)) << "}";
+		}
+	}
+
+	return true;
+}
+
+bool QueryServer::queryFunction(const Json::Object &request, std::stringstream &results)
+{
+	std::string name;
+	uint64_t address;
+
+	if (Json::getString(request, "name", &name))
+	{
+		auto it = m_functionsByName.find(name);
+
+		if (it == m_functionsByName.end())
+			return true;
+
+		for (size_t i = 0; i < it->second.size(); i++)
+		{
+			if (i != 0)
+				results << ",";
+
+			results << functionToJson(it->second[i]);
+		}
+
+		return true;
+	}
+
+	if (Json::getUnsigned(request, "address", &address))
+	{
+		// Find the last function starting at or before the address
+		auto it = std::upper_bound(m_functionsByAddress.begin(), m_functionsByAddress.end(), address,
+			[](uint64_t addr, const FunctionRef &ref) { return addr < ref.function->startAddress; });
+
+		if (it == m_functionsByAddress.begin())
+			return true;
+
+		--it;
+
+		Cpp::Function *fun = it->function;
+		unsigned int end = (fun->endAddress > fun->startAddress) ? fun->endAddress : fun->startAddress + 1;
+
+		if (address < end)
+			results << functionToJson(*it);
+		else if (m_symbols)
+		{
+			// Code without DWARF information can still have a symbol
+			const SymbolTable::Symbol *sym = m_symbols->findByAddress((Elf32_Addr)address);
+
+			if (sym && sym->type == STT_FUNC)
+				results << symbolToJson(*sym);
+		}
+
+		return true;
+	}
+
+	m_error = "Expected \"name\" or \"address\".";
+	return false;
+}
+
+bool QueryServer::querySymbol(const Json::Object &request, std::stringstream &results)
+{
+	std::string name;
+	uint64_t address;
+	const SymbolTable::Symbol *sym = nullptr;
+
+	if (!m_symbols)
+	{
+		m_error = "No symbol table loaded.";
+		return false;
+	}
+
+	if (Json::getString(request, "name", &name))
+		sym = m_symbols->findByName(name);
+	else if (Json::getUnsigned(request, "address", &address))
+		sym = m_symbols->findByAddress((Elf32_Addr)address);
+	else
+	{
+		m_error = "Expected \"name\" or \"address\".";
+		return false;
+	}
+
+	if (sym)
+		results << symbolToJson(*sym);
+
+	return true;
+}
+
+bool QueryServer::querySearch(const Json::Object &request, std::stringstream &results)
+{
+	std::string query;
+	uint64_t limit = 20;
+
+	if (!Json::getString(request, "query", &query))
+	{
+		m_error = "Missing \"query\".";
+		return false;
+	}
+
+	Json::getUnsigned(request, "limit", &limit);
+
+	std::vector<NameIndex::Match> matches = m_nameIndex.search(query, (size_t)limit);
+
+	for (size_t i = 0; i < matches.size(); i++)
+	{
+		const NameIndex::Item &item = *matches[i].item;
+		NameIndex::Kind kind = (NameIndex::Kind)item.kind;
+
+		if (i != 0)
+			results << ",";
+
+		results << "{\"name\":" << Json::escape(m_nameIndex.getString(item.name)) <<
+			",\"kind\":" << Json::escape(kind == NameIndex::KIND_TYPE ? m_nameIndex.getString(item.detail) : NameIndex::kindToString(kind));
+
+		if (item.owner != 0)
+			results << ",\"owner\":" << Json::escape(m_nameIndex.getString(item.owner));
+
+		if (kind == NameIndex::KIND_MEMBER)
+			results << ",\"offset\":" << item.detail;
+
+		results << ",\"cu\":" << Json::escape(m_nameIndex.getString(item.file)) <<
+			",\"address\":" << Json::escape(Cpp::toHexString(item.address)) <<
+			",\"score\":" << matches[i].score <<
+			",\"substring\":" << (matches[i].substring ? "true" : "false") << "}";
+	}
+
+	return true;
+}
+
+bool QueryServer::queryRender(const Json::Object &request, std::stringstream &results)
+{
+	std::string name;
+
+	if (!Json::getString(request, "cu", &name))
+	{
+		m_error = "Missing \"cu\".";
+		return false;
+	}
+
+	auto it = m_filesByName.find(name);
+
+	if (it == m_filesByName.end())
+		return true;
+
+	results << "{\"cu\":" << Json::escape(name) <<
+		",\"text\":" << Json::escape(it->second->toString(false, false)) << "}";
+
+	return true;
+}
+
+std::string QueryServer::typeToJson(const TypeRef &ref)
+{
+	Cpp::UserType *ut = ref.type;
+	std::stringstream ss;
+
+	ss << "{\"cu\":" << Json::escape(ref.file->filename) <<
+		",\"name\":" << Json::escape(ut->name) <<
+		",\"kind\":" << Json::escape(ut->toKindString());
+
+	const Cpp::Layout &layout = ut->getLayout();
+
+	ss << ",\"size\":" << layout.size << ",\"alignment\":" << layout.alignment << ",\"holes\":[";
+
+	for (size_t i = 0; i < layout.holes.size(); i++)
+	{
+		if (i != 0)
+			ss << ",";
+
+		ss << "{\"offset\":" << layout.holes[i].offset << ",\"size\":" << layout.holes[i].size << "}";
+	}
+
+	ss << "]";
+
+	if (ut->type == Cpp::UserType::ARRAY || ut->type == Cpp::UserType::FUNCTION)
+		ss << ",\"definition\":" << Json::escape(ut->toDeclarationString());
+	else
+		ss << ",\"definition\":" << Json::escape(ut->toDefinitionString(true));
+
+	ss << "}";
+
+	return ss.str();
+}
+
+std::string QueryServer::functionToJson(const FunctionRef &ref)
+{
+	Cpp::Function *fun = ref.function;
+	std::stringstream ss;
+
+	ss << "{\"cu\":" << Json::escape(ref.file->filename) <<
+		",\"name\":" << Json::escape(fun->name) <<
+		",\"mangledName\":" << Json::escape(fun->mangledName) <<
+		",\"startAddress\":" << Json::escape(Cpp::toHexString(fun->startAddress)) <<
+		",\"endAddress\":" << Json::escape(Cpp::toHexString(fun->endAddress)) <<
+		",\"size\":" << fun->size <<
+		",\"signature\":" << Json::escape(fun->toNameString()) <<
+		",\"definition\":" << Json::escape(fun->toDefinitionString()) << "}";
+
+	return ss.str();
+}
+
+std::string QueryServer::symbolToJson(const SymbolTable::Symbol &sym)
+{
+	std::stringstream ss;
+
+	ss << "{\"symbol\":" << Json::escape(sym.name) <<
+		",\"kind\":" << Json::escape(sym.type == STT_FUNC ? "function" : "object") <<
+		",\"address\":" << Json::escape(Cpp::toHexString(sym.address)) <<
+		",\"size\":" << sym.size << "}";
+
+	return ss.str();
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "cpp.h"
+#include "json.h"
+#include "symtab.h"
+#include "search.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// Answers JSON-lines queries about an already converted program.
+// Every request is one JSON object per line, and every response is one line.
+//
+// {"cmd":"cus"}
+// {"cmd":"type","name":"xEnt"}
+// {"cmd":"members","type":"xEnt","offset":16}
+// {"cmd":"function","name":"Update"} / {"cmd":"function","address":"0x80001010"}
+// {"cmd":"symbol","name":"gEnt0"} / {"cmd":"symbol","address":"0x80400000"}
+// {"cmd":"search","query":"Cam","limit":20}
+// {"cmd":"render","cu":"C:\\SB\\Core\\x\\xEnt.cpp"}
+// {"cmd":"quit"}
+//
+// An "id" given in a request is echoed back in its response.
+class QueryServer
+{
+public:
+	// symbols is optional, and backs address lookups that no function covers
+	QueryServer(std::vector<Cpp::File*> &files, const SymbolTable *symbols = nullptr);
+
+	int run(std::istream &in, std::ostream &out);
+	std::string handle(const std::string &request);
+
+private:
+	struct TypeRef
+	{
+		Cpp::File *file;
+		Cpp::UserType *type;
+	};
+
+	struct FunctionRef
+	{
+		Cpp::File *file;
+		Cpp::Function *function;
+	};
+
+	std::vector<Cpp::File*> &m_files;
+	std::unordered_map<std::string, Cpp::File*> m_filesByName;
+	std::unordered_map<std::string, std::vector<TypeRef>> m_typesByName;
+	std::unordered_map<std::string, std::vector<FunctionRef>> m_functionsByName;
+	std::vector<FunctionRef> m_functionsByAddress;
+	const SymbolTable *m_symbols;
+	NameIndex m_nameIndex;
+
+	bool queryCompileUnits(const Json::Object &request, std::stringstream &results);
+	bool queryType(const Json::Object &request, std::stringstream &results);
+	bool queryMembers(const Json::Object &request, std::stringstream &results);
+	bool queryFunction(const Json::Object &request, std::stringstream &results);
+	bool querySymbol(const Json::Object &request, std::stringstream &results);
+	bool querySearch(const Json::Object &request, std::stringstream &results);
+	bool queryRender(const Json::Object &request, std::stringstream &results);
+
+	std::string typeToJson(const TypeRef &ref);
+	std::string functionToJson(const FunctionRef &ref);
+	std::string symbolToJson(const SymbolTable::Symbol &sym);
+
+	std::string m_error;
+};
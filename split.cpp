@@ -0,0 +1,182 @@
+#include "split.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#include <experimental/filesystem>
+
+namespace filesystem = std::experimental::filesystem;
+
+TypeHeaderGraph::TypeHeaderGraph(std::vector<Cpp::File*> &files)
+{
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		for (Cpp::UserType *ut : files[i]->userTypes)
+		{
+			// Generated names are only unique within a compile unit
+			if (ut->anonymous)
+				m_names[ut] = "cu" + std::to_string(i) + "_" + ut->name;
+
+			addHeader(ut);
+		}
+	}
+
+	for (std::unique_ptr<TypeHeader> &header : m_nodes)
+		addDependencies(header.get());
+}
+
+TypeHeader* TypeHeaderGraph::addHeader(Cpp::UserType *ut)
+{
+	auto named = m_names.find(ut);
+	const std::string &name = (named != m_names.end()) ? named->second : ut->name;
+	auto it = m_byName.find(name);
+
+	if (it != m_byName.end())
+	{
+		Cpp::UserType *first = it->second->type;
+
+		// Each compile unit only has the methods it defines, so collect them all
+		if (isClassType(ut) && isClassType(first) && !ut->classData->functions.empty())
+		{
+			auto merged = m_functions.find(first);
+
+			if (merged == m_functions.end())
+				merged = m_functions.emplace(first, first->classData->functions).first;
+
+			std::set<std::string> declarations;
+
+			for (Cpp::Function &fun : merged->second)
+				declarations.insert(fun.toDeclarationString());
+
+			for (Cpp::Function &fun : ut->classData->functions)
+			{
+				if (declarations.insert(fun.toDeclarationString()).second)
+					merged->second.push_back(fun);
+			}
+		}
+
+		m_byType[ut] = it->second;
+		return it->second;
+	}
+
+	TypeHeader *header = new TypeHeader();
+	header->type = ut;
+	header->filename = getFilename(name);
+
+	m_nodes.emplace_back(header);
+	m_byName[name] = header;
+	m_byType[ut] = header;
+
+	return header;
+}
+
+TypeHeader* TypeHeaderGraph::getNode(Cpp::UserType *ut)
+{
+	auto it = m_byType.find(ut);
+	return (it != m_byType.end()) ? it->second : nullptr;
+}
+
+std::string TypeHeaderGraph::getFilename(const std::string &name)
+{
+	std::string filename = name;
+
+	for (char &c : filename)
+	{
+		if (!isalnum((unsigned char)c) && c != '_')
+			c = '_';
+	}
+
+	// Compared case insensitively, so headers don't collide on Windows
+	std::string base = filename;
+	std::string key;
+
+	for (int i = 1;; i++)
+	{
+		key = filename;
+
+		for (char &c : key)
+			c = tolower((unsigned char)c);
+
+		if (m_filenames.insert(key).second)
+			break;
+
+		filename = base + "_" + std::to_string(i);
+	}
+
+	return filename + ".h";
+}
+
+void TypeHeaderGraph::write(const char *outDirectory)
+{
+	std::vector<TypeHeader*> order;
+
+	for (std::unique_ptr<TypeHeader> &header : m_nodes)
+		sort(header.get(), order);
+
+	filesystem::path directory(outDirectory);
+	filesystem::create_directories(directory / "types");
+
+	std::cout << "Writing " << order.size() << " type headers to " << (directory / "types").make_preferred() << "..." << std::endl;
+
+	// The files are left as they were once the headers are written
+	swapNames();
+	swapFunctions();
+
+	for (TypeHeader *header : order)
+	{
+		std::stringstream ss;
+		ss << "#pragma once\n\n";
+
+		if (!header->needs.empty())
+		{
+			for (TypeHeader *include : header->needs)
+				ss << "#include \"" << include->filename << "\"\n";
+
+			ss << "\n";
+		}
+
+		if (!header->declarations.empty())
+		{
+			for (TypeHeader *declaration : header->declarations)
+				ss << declaration->type->toDeclarationString() << "\n";
+
+			ss << "\n";
+		}
+
+		Cpp::UserType *ut = header->type;
+
+		if (ut->type == Cpp::UserType::ARRAY || ut->type == Cpp::UserType::FUNCTION)
+			ss << ut->toDeclarationString() << "\n";
+		else
+			ss << ut->toDefinitionString(false) << "\n";
+
+		std::string str = ss.str();
+
+		std::ofstream file(directory / "types" / header->filename);
+		file.write(str.data(), str.size());
+	}
+
+	swapFunctions();
+	swapNames();
+
+	std::ofstream file(directory / "types.h");
+	file << "#pragma once\n\n";
+
+	for (TypeHeader *header : order)
+		file << "#include \"types/" << header->filename << "\"\n";
+}
+
+// Gives the classes in m_functions the methods of every compile unit, or back their own ones
+void TypeHeaderGraph::swapFunctions()
+{
+	for (auto &x : m_functions)
+		std::swap(x.first->classData->functions, x.second);
+}
+
+void writeTypeHeaders(std::vector<Cpp::File*> &files, const char *outDirectory)
+{
+	TypeHeaderGraph graph(files);
+	graph.write(outDirectory);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "cpp.h"
+#include "typegraph.h"
+
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct TypeHeader : TypeGraphNode<TypeHeader>
+{
+	std::string filename;
+};
+
+// Splits the user types of all files into one header per type. A header
+// includes the headers of the types it needs complete, and only forward
+// declares classes it refers to through pointers or references. Types with
+// the same name in different compile units share one header.
+class TypeHeaderGraph : public TypeGraph<TypeHeader>
+{
+public:
+	TypeHeaderGraph(std::vector<Cpp::File*> &files);
+
+	// Writes every header to outDirectory/types, and outDirectory/types.h which
+	// includes all of them in dependency order
+	void write(const char *outDirectory);
+
+protected:
+	TypeHeader* getNode(Cpp::UserType *ut) override;
+
+private:
+	std::set<std::string> m_filenames;
+
+	// The methods of every compile unit, for classes defined in more than
+	// one. Like m_names, the classes only have them while they're written.
+	std::unordered_map<Cpp::UserType*, Cpp::Vector<Cpp::Function>> m_functions;
+
+	TypeHeader* addHeader(Cpp::UserType *ut);
+	std::string getFilename(const std::string &name);
+	void swapFunctions();
+};
+
+void writeTypeHeaders(std::vector<Cpp::File*> &files, const char *outDirectory);
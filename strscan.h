@@ -0,0 +1,146 @@
+/******************************************************************/
+/* Vectorised scanning of null-terminated strings in DWARF data.  */
+/* Finds the terminator and (optionally) a special character in a */
+/* single pass, using AVX2 or SSE2 when available.                */
+/******************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#define STRSCAN_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define STRSCAN_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace StrScan
+{
+static const size_t npos = (size_t)-1;
+
+struct Result
+{
+	size_t length;       // Number of bytes before the terminator
+	size_t firstSpecial; // Index of the first special character, or npos
+};
+
+inline unsigned int countTrailingZeros(uint32_t x)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, x);
+	return index;
+#else
+	return __builtin_ctz(x);
+#endif
+}
+
+// Scalar fallback, also used to finish off chunks the vector paths can't read.
+inline Result scanScalar(const char *str, char special)
+{
+	Result result = { 0, npos };
+	const char *p = str;
+
+	while (*p)
+	{
+		if (*p == special && result.firstSpecial == npos)
+			result.firstSpecial = p - str;
+		p++;
+	}
+
+	result.length = p - str;
+	return result;
+}
+
+// Scans the null-terminated string at str, returning its length and the index
+// of the first occurrence of special. Pass '\0' as special to just get the length.
+// Vector loads are aligned so they never cross into a page the string doesn't touch.
+inline Result scan(const char *str, char special = '\0')
+{
+#if defined(STRSCAN_AVX2) || defined(STRSCAN_SSE2)
+#if defined(STRSCAN_AVX2)
+	const size_t width = 32;
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i spec = _mm256_set1_epi8(special);
+#define STRSCAN_LOAD(p) _mm256_load_si256((const __m256i*)(p))
+#define STRSCAN_MASK(v, c) (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, c))
+#else
+	const size_t width = 16;
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i spec = _mm_set1_epi8(special);
+#define STRSCAN_LOAD(p) _mm_load_si128((const __m128i*)(p))
+#define STRSCAN_MASK(v, c) (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, c))
+#endif
+
+	Result result = { 0, npos };
+
+	uintptr_t misalign = (uintptr_t)str & (width - 1);
+	const char *chunk = str - misalign;
+
+	// Ignore the bytes before the start of the string in the first chunk
+	uint32_t skip = (uint32_t)(~0ull << misalign);
+
+	for (;;)
+	{
+		auto v = STRSCAN_LOAD(chunk);
+		uint32_t nullMask = STRSCAN_MASK(v, zero) & skip;
+		uint32_t specMask = (special != '\0') ? (STRSCAN_MASK(v, spec) & skip) : 0;
+
+		if (nullMask)
+		{
+			unsigned int end = countTrailingZeros(nullMask);
+
+			// Only specials before the terminator count
+			specMask &= (1u << end) - 1;
+
+			if (specMask && result.firstSpecial == npos)
+				result.firstSpecial = chunk + countTrailingZeros(specMask) - str;
+
+			result.length = chunk + end - str;
+			return result;
+		}
+
+		if (specMask && result.firstSpecial == npos)
+			result.firstSpecial = chunk + countTrailingZeros(specMask) - str;
+
+		chunk += width;
+		skip = ~0u;
+	}
+
+#undef STRSCAN_LOAD
+#undef STRSCAN_MASK
+#else
+	return scanScalar(str, special);
+#endif
+}
+
+inline size_t length(const char *str)
+{
+	return scan(str).length;
+}
+
+// Replaces every occurrence of ch in the first length bytes of str, starting
+// at the already known first occurrence.
+inline void replace(char *str, size_t length, size_t first, char ch, char newCh)
+{
+	if (first == npos)
+		return;
+
+	char *p = str + first;
+	char *end = str + length;
+
+	while (p && p < end)
+	{
+		*p = newCh;
+		p = (char*)memchr(p + 1, ch, end - (p + 1));
+	}
+}
+}
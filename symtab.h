@@ -0,0 +1,145 @@
+/**************************************************************/
+/* Index over an ELF file's .symtab, for symbols that have no */
+/* (or incomplete) DWARF information.                         */
+/**************************************************************/
+
+#pragma once
+
+#include "elf.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+class SymbolTable
+{
+public:
+	struct Symbol
+	{
+		std::string name;
+		Elf32_Addr address;
+		Elf32_Word size;
+		unsigned char type;
+		unsigned char binding;
+	};
+
+	// Reads the function and object symbols of elf. Files without a symbol
+	// table give an empty index.
+	SymbolTable(ElfFile *elf)
+	{
+		Elf32_Shdr *symtab = nullptr;
+
+		for (Elf32_Half i = 0; i < elf->getSectionCount(); i++)
+		{
+			if (elf->getSectionHeader(i)->sh_type == SHT_SYMTAB)
+			{
+				symtab = elf->getSectionHeader(i);
+				break;
+			}
+		}
+
+		if (!symtab || symtab->sh_link >= elf->getSectionCount())
+			return;
+
+		Elf32_Shdr *strtab = elf->getSectionHeader(symtab->sh_link);
+		const char *strings = elf->getSectionData(strtab);
+		Elf32_Word numSymbols = symtab->sh_size / sizeof(Elf32_Sym);
+		Elf32_Sym *sym = (Elf32_Sym*)elf->getSectionData(symtab);
+
+		m_symbols.reserve(numSymbols);
+
+		for (Elf32_Word i = 0; i < numSymbols; i++, sym++)
+		{
+			unsigned char type = ELF32_ST_TYPE(sym->st_info);
+			Elf32_Word name = elf->read<Elf32_Word>(&sym->st_name);
+
+			if ((type != STT_FUNC && type != STT_OBJECT) || elf->read<Elf32_Half>(&sym->st_shndx) == SHN_UNDEF)
+				continue;
+
+			if (name >= strtab->sh_size)
+				continue;
+
+			Symbol symbol;
+			symbol.name.assign(strings + name, strnlen(strings + name, strtab->sh_size - name));
+			symbol.address = elf->read<Elf32_Addr>(&sym->st_value);
+			symbol.size = elf->read<Elf32_Word>(&sym->st_size);
+			symbol.type = type;
+			symbol.binding = ELF32_ST_BIND(sym->st_info);
+
+			m_symbols.push_back(symbol);
+		}
+
+		std::sort(m_symbols.begin(), m_symbols.end(),
+			[](const Symbol &a, const Symbol &b) { return a.address < b.address; });
+
+		for (size_t i = 0; i < m_symbols.size(); i++)
+		{
+			bool isLocal = (m_symbols[i].binding == STB_LOCAL);
+			auto it = m_byName.find(m_symbols[i].name);
+
+			if (it == m_byName.end())
+			{
+				m_byName[m_symbols[i].name] = (int)i;
+				continue;
+			}
+
+			// A global symbol wins over local ones with the same name, but
+			// local ones from different files can't be told apart
+			int &current = it->second;
+
+			if (current == AMBIGUOUS)
+			{
+				if (!isLocal)
+					current = (int)i;
+			}
+			else if (m_symbols[current].binding == STB_LOCAL)
+				current = isLocal ? AMBIGUOUS : (int)i;
+		}
+	}
+
+	// Returns the symbol with that name, or nullptr if there is none or the
+	// name only belongs to several local symbols
+	const Symbol* findByName(const std::string &name) const
+	{
+		auto it = m_byName.find(name);
+
+		if (it == m_byName.end() || it->second == AMBIGUOUS)
+			return nullptr;
+
+		return &m_symbols[it->second];
+	}
+
+	// Returns the symbol whose range contains the address. Symbols without
+	// a size only match their own address.
+	const Symbol* findByAddress(Elf32_Addr address) const
+	{
+		auto it = std::upper_bound(m_symbols.begin(), m_symbols.end(), address,
+			[](Elf32_Addr addr, const Symbol &sym) { return addr < sym.address; });
+
+		// Aliases share an address, and only some of them may have a size
+		while (it != m_symbols.begin())
+		{
+			--it;
+
+			if (address < it->address + (it->size ? it->size : 1))
+				return &*it;
+
+			if (it == m_symbols.begin() || (it - 1)->address != it->address)
+				break;
+		}
+
+		return nullptr;
+	}
+
+	inline const std::vector<Symbol>& getSymbols() const
+	{
+		return m_symbols;
+	}
+
+private:
+	static const int AMBIGUOUS = -1;
+
+	std::vector<Symbol> m_symbols;
+	std::unordered_map<std::string, int> m_byName;
+};
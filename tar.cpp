@@ -0,0 +1,434 @@
+#include "tar.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+#define TAR_BLOCK_SIZE 512
+
+// Buffer size for the archive, so it's written in large sequential chunks
+#define TAR_BUFFER_SIZE (1 << 20)
+
+#define DEFLATE_WINDOW    32768
+#define DEFLATE_HASH_BITS 15
+#define DEFLATE_MIN_MATCH 3
+#define DEFLATE_MAX_MATCH 258
+
+// Candidates tried per position. Rendered C++ repeats itself a lot, so a
+// short search already finds most matches.
+#define DEFLATE_MAX_CHAIN 32
+
+static const uint16_t lengthBase[29] =
+{
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const uint8_t lengthExtra[29] =
+{
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const uint16_t distanceBase[30] =
+{
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const uint8_t distanceExtra[30] =
+{
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static uint32_t reverseBits(uint32_t code, int length)
+{
+	uint32_t reversed = 0;
+
+	for (int i = 0; i < length; i++)
+		reversed |= ((code >> i) & 1) << (length - 1 - i);
+
+	return reversed;
+}
+
+// The fixed Huffman codes, bit reversed because deflate sends codes most
+// significant bit first but everything else least significant bit first
+struct FixedCodes
+{
+	uint16_t literal[288];
+	uint8_t literalLength[288];
+	uint8_t lengthCode[DEFLATE_MAX_MATCH + 1]; // Match length to index into lengthBase
+	uint32_t crc[256];
+
+	FixedCodes()
+	{
+		for (int i = 0; i < 288; i++)
+		{
+			if (i < 144)
+				literalLength[i] = 8, literal[i] = reverseBits(0x30 + i, 8);
+			else if (i < 256)
+				literalLength[i] = 9, literal[i] = reverseBits(0x190 + i - 144, 9);
+			else if (i < 280)
+				literalLength[i] = 7, literal[i] = reverseBits(i - 256, 7);
+			else
+				literalLength[i] = 8, literal[i] = reverseBits(0xc0 + i - 280, 8);
+		}
+
+		for (int code = 0; code < 29; code++)
+		{
+			int end = (code == 28) ? DEFLATE_MAX_MATCH + 1 : lengthBase[code + 1];
+
+			for (int length = lengthBase[code]; length < end; length++)
+				lengthCode[length] = code;
+		}
+
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t c = i;
+
+			for (int k = 0; k < 8; k++)
+				c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+
+			crc[i] = c;
+		}
+	}
+};
+
+static const FixedCodes fixedCodes;
+
+// Compresses a stream into gzip format as it's written
+class Deflater
+{
+public:
+	Deflater(std::ostream &out) : m_out(out), m_head(1 << DEFLATE_HASH_BITS, -1), m_prev(DEFLATE_WINDOW, -1)
+	{
+		static const unsigned char header[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 3 };
+		m_out.write((const char*)header, sizeof(header));
+
+		// A single block of fixed codes, ended by an empty final block in finish()
+		putBits(0 | (1 << 1), 3);
+	}
+
+	void write(const char *data, size_t size)
+	{
+		for (size_t i = 0; i < size; i++)
+			m_crc = fixedCodes.crc[(m_crc ^ (unsigned char)data[i]) & 0xff] ^ (m_crc >> 8);
+
+		m_totalSize += size;
+		m_data.insert(m_data.end(), data, data + size);
+
+		if (m_data.size() - (m_pos - m_base) >= 4 * DEFLATE_WINDOW)
+			compress(false);
+	}
+
+	void finish()
+	{
+		compress(true);
+
+		putSymbol(256);
+		putBits(1 | (1 << 1), 3);
+		putSymbol(256);
+
+		if (m_bitCount > 0)
+			putBits(0, 8 - m_bitCount);
+
+		flushBytes();
+
+		uint32_t crc = ~m_crc;
+		uint32_t size = (uint32_t)m_totalSize;
+		unsigned char trailer[8];
+
+		for (int i = 0; i < 4; i++)
+		{
+			trailer[i] = (crc >> (i * 8)) & 0xff;
+			trailer[4 + i] = (size >> (i * 8)) & 0xff;
+		}
+
+		m_out.write((const char*)trailer, sizeof(trailer));
+	}
+
+private:
+	std::ostream &m_out;
+	std::vector<char> m_data; // The last window of encoded bytes, then the bytes still to encode
+	int64_t m_base = 0; // Stream position of m_data[0]
+	int64_t m_pos = 0; // Stream position of the next byte to encode
+	std::vector<int64_t> m_head; // Latest position per hash of three bytes
+	std::vector<int64_t> m_prev; // Previous position with the same hash, per position in the window
+
+	uint64_t m_bits = 0;
+	int m_bitCount = 0;
+	std::string m_bytes;
+
+	uint32_t m_crc = 0xffffffff;
+	uint64_t m_totalSize = 0;
+
+	inline uint32_t hashAt(int64_t pos) const
+	{
+		const unsigned char *p = (const unsigned char*)&m_data[pos - m_base];
+		return ((p[0] << 10) ^ (p[1] << 5) ^ p[2]) & ((1 << DEFLATE_HASH_BITS) - 1);
+	}
+
+	inline void insert(int64_t pos)
+	{
+		uint32_t h = hashAt(pos);
+		m_prev[pos & (DEFLATE_WINDOW - 1)] = m_head[h];
+		m_head[h] = pos;
+	}
+
+	// Encodes everything but the last DEFLATE_MAX_MATCH bytes, which later
+	// data may still extend a match into, unless flushing
+	void compress(bool flush)
+	{
+		int64_t limit = m_base + (int64_t)m_data.size();
+		int64_t end = flush ? limit : limit - DEFLATE_MAX_MATCH;
+
+		while (m_pos < end)
+		{
+			int bestLength = 0;
+			int bestDistance = 0;
+
+			if (limit - m_pos >= DEFLATE_MIN_MATCH)
+			{
+				int maxLength = (int)std::min<int64_t>(DEFLATE_MAX_MATCH, limit - m_pos);
+				const char *current = &m_data[m_pos - m_base];
+				int64_t candidate = m_head[hashAt(m_pos)];
+
+				for (int chain = 0; chain < DEFLATE_MAX_CHAIN && candidate >= 0 && m_pos - candidate <= DEFLATE_WINDOW; chain++)
+				{
+					const char *match = &m_data[candidate - m_base];
+
+					if (match[bestLength] == current[bestLength])
+					{
+						int length = 0;
+
+						while (length < maxLength && match[length] == current[length])
+							length++;
+
+						if (length > bestLength)
+						{
+							bestLength = length;
+							bestDistance = (int)(m_pos - candidate);
+
+							if (length == maxLength)
+								break;
+						}
+					}
+
+					int64_t next = m_prev[candidate & (DEFLATE_WINDOW - 1)];
+
+					// The slot was reused by a newer position, so the chain ends here
+					if (next >= candidate)
+						break;
+
+					candidate = next;
+				}
+			}
+
+			if (bestLength >= DEFLATE_MIN_MATCH)
+			{
+				putMatch(bestLength, bestDistance);
+
+				for (int64_t i = m_pos; i < m_pos + bestLength && i + DEFLATE_MIN_MATCH <= limit; i++)
+					insert(i);
+
+				m_pos += bestLength;
+			}
+			else
+			{
+				putSymbol((unsigned char)m_data[m_pos - m_base]);
+
+				if (m_pos + DEFLATE_MIN_MATCH <= limit)
+					insert(m_pos);
+
+				m_pos++;
+			}
+		}
+
+		// Keep one window of history
+		if (m_pos - m_base > 2 * DEFLATE_WINDOW)
+		{
+			int64_t drop = m_pos - DEFLATE_WINDOW - m_base;
+			m_data.erase(m_data.begin(), m_data.begin() + drop);
+			m_base += drop;
+		}
+
+		flushBytes();
+	}
+
+	inline void putBits(uint32_t value, int count)
+	{
+		m_bits |= (uint64_t)value << m_bitCount;
+		m_bitCount += count;
+
+		while (m_bitCount >= 8)
+		{
+			m_bytes.push_back((char)(m_bits & 0xff));
+			m_bits >>= 8;
+			m_bitCount -= 8;
+		}
+	}
+
+	inline void putSymbol(int symbol)
+	{
+		putBits(fixedCodes.literal[symbol], fixedCodes.literalLength[symbol]);
+	}
+
+	void putMatch(int length, int distance)
+	{
+		int code = fixedCodes.lengthCode[length];
+
+		putSymbol(257 + code);
+		putBits(length - lengthBase[code], lengthExtra[code]);
+
+		code = (int)(std::upper_bound(distanceBase, distanceBase + 30, distance) - distanceBase) - 1;
+
+		putBits(reverseBits(code, 5), 5);
+		putBits(distance - distanceBase[code], distanceExtra[code]);
+	}
+
+	void flushBytes()
+	{
+		m_out.write(m_bytes.data(), m_bytes.size());
+		m_bytes.clear();
+	}
+};
+
+TarWriter::TarWriter() : m_time(0)
+{
+}
+
+TarWriter::~TarWriter()
+{
+}
+
+bool TarWriter::open(const char *filename, bool compress)
+{
+	m_buffer.reset(new char[TAR_BUFFER_SIZE]);
+	m_file.rdbuf()->pubsetbuf(m_buffer.get(), TAR_BUFFER_SIZE);
+	m_file.open(filename, std::ios::binary);
+
+	if (!m_file)
+		return false;
+
+	if (compress)
+		m_deflater.reset(new Deflater(m_file));
+
+	m_time = (int64_t)std::time(nullptr);
+
+	return true;
+}
+
+void TarWriter::addFile(const std::string &name, const char *data, size_t size)
+{
+	writeHeader(name, size, '0');
+	write(data, size);
+	pad(size);
+}
+
+bool TarWriter::close()
+{
+	char end[2 * TAR_BLOCK_SIZE] = {};
+	write(end, sizeof(end));
+
+	if (m_deflater)
+		m_deflater->finish();
+
+	m_file.close();
+
+	return !m_file.fail();
+}
+
+// Writes value as a null terminated octal number filling the field, or in
+// the GNU base-256 form if it doesn't fit
+static void putNumber(char *field, size_t size, uint64_t value)
+{
+	if (value >> (3 * (size - 1)))
+	{
+		memset(field, 0, size);
+		field[0] = (char)0x80;
+
+		for (size_t i = size - 1; i > 0 && value; i--, value >>= 8)
+			field[i] = (char)(value & 0xff);
+
+		return;
+	}
+
+	field[size - 1] = '\0';
+
+	for (size_t i = size - 1; i > 0; i--, value >>= 3)
+		field[i - 1] = '0' + (value & 7);
+}
+
+void TarWriter::writeHeader(const std::string &name, size_t size, char type)
+{
+	char header[TAR_BLOCK_SIZE] = {};
+	size_t split = std::string::npos;
+
+	if (name.size() > 100)
+	{
+		// Split at a slash into the prefix and name fields
+		for (size_t i = name.find('/'); i != std::string::npos; i = name.find('/', i + 1))
+		{
+			if (i <= 155 && name.size() - i - 1 <= 100)
+			{
+				split = i;
+				break;
+			}
+		}
+
+		if (split == std::string::npos)
+		{
+			writeHeader("././@LongLink", name.size() + 1, 'L');
+			write(name.c_str(), name.size() + 1);
+			pad(name.size() + 1);
+		}
+	}
+
+	if (split != std::string::npos)
+	{
+		memcpy(header + 345, name.data(), split);
+		memcpy(header, name.data() + split + 1, name.size() - split - 1);
+	}
+	else
+		memcpy(header, name.data(), std::min<size_t>(name.size(), 100));
+
+	putNumber(header + 100, 8, 0644);
+	putNumber(header + 108, 8, 0);
+	putNumber(header + 116, 8, 0);
+	putNumber(header + 124, 12, size);
+	putNumber(header + 136, 12, (uint64_t)m_time);
+	header[156] = type;
+	memcpy(header + 257, "ustar", 6);
+	memcpy(header + 263, "00", 2);
+
+	// The checksum is taken with its own field filled with spaces
+	memset(header + 148, ' ', 8);
+
+	uint32_t checksum = 0;
+
+	for (int i = 0; i < TAR_BLOCK_SIZE; i++)
+		checksum += (unsigned char)header[i];
+
+	putNumber(header + 148, 7, checksum);
+
+	write(header, TAR_BLOCK_SIZE);
+}
+
+void TarWriter::write(const char *data, size_t size)
+{
+	if (m_deflater)
+		m_deflater->write(data, size);
+	else
+		m_file.write(data, size);
+}
+
+// Pads a file of size bytes to a whole number of blocks
+void TarWriter::pad(size_t size)
+{
+	static const char zeros[TAR_BLOCK_SIZE] = {};
+
+	if (size % TAR_BLOCK_SIZE)
+		write(zeros, TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE);
+}
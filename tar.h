@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+
+class Deflater;
+
+// Writes a POSIX ustar archive in one sequential pass, optionally gzip
+// compressed. Compression uses the fixed Huffman codes of deflate with greedy
+// LZ77 matching, so it's fast and needs no tables to be sent, at some cost in
+// ratio compared to gzip's own.
+//
+// Names longer than the ustar fields allow are stored with a GNU long name
+// entry before the file, which every common tar reads.
+class TarWriter
+{
+public:
+	TarWriter();
+	~TarWriter();
+
+	bool open(const char *filename, bool compress);
+
+	// Adds a regular file. name uses forward slashes.
+	void addFile(const std::string &name, const char *data, size_t size);
+
+	// Writes the end of archive marker, and the gzip trailer if compressed.
+	// Returns false if anything failed to be written.
+	bool close();
+
+private:
+	std::ofstream m_file;
+	std::unique_ptr<char[]> m_buffer;
+	std::unique_ptr<Deflater> m_deflater;
+	int64_t m_time;
+
+	void writeHeader(const std::string &name, size_t size, char type);
+	void write(const char *data, size_t size);
+	void pad(size_t size);
+};
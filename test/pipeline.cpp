@@ -0,0 +1,219 @@
+/**************************************************************/
+/* Regression tests for the pipelined conversion. Each case   */
+/* converts DWARF data generated in memory with one thread    */
+/* and with runPipeline, and fails if the output differs.     */
+/**************************************************************/
+
+#include "../bench/fixture.h"
+#include "../convert.h"
+#include "../output.h"
+#include "../pipeline.h"
+
+#include <experimental/filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace filesystem = std::experimental::filesystem;
+
+// Compile units between the ones a case is about, so the pipeline has
+// written the early files before it converts the late ones
+#define FILLER_UNITS 64
+
+#define PIPELINE_JOBS 8
+
+static void addFillerUnit(FixtureBuilder &b, int index)
+{
+	std::string suffix = std::to_string(index);
+
+	b.begin(DW_TAG_compile_unit);
+	b.string(DW_AT_name, "src/filler" + suffix + ".cpp");
+	b.children();
+
+	Elf32_Off filler = b.begin(DW_TAG_structure_type);
+	b.string(DW_AT_name, "Filler" + suffix);
+	b.data4(DW_AT_byte_size, 4);
+	b.children();
+	b.begin(DW_TAG_member);
+	b.string(DW_AT_name, "value");
+	b.data2(DW_AT_fund_type, DW_FT_signed_integer);
+	b.block2(DW_AT_location, location(0));
+	b.leaf();
+	b.close();
+
+	b.begin(DW_TAG_global_variable);
+	b.string(DW_AT_name, "gFiller" + suffix);
+	b.data4(DW_AT_user_def_type, filler);
+	b.leaf();
+
+	b.close();
+}
+
+// Starts a compile unit defining a struct called name, and returns the struct's offset
+static Elf32_Off addStructUnit(FixtureBuilder &b, const std::string &filename, const std::string &name)
+{
+	b.begin(DW_TAG_compile_unit);
+	b.string(DW_AT_name, filename);
+	b.children();
+
+	Elf32_Off type = b.begin(DW_TAG_structure_type);
+	b.string(DW_AT_name, name);
+	b.data4(DW_AT_byte_size, 4);
+	b.children();
+	b.begin(DW_TAG_member);
+	b.string(DW_AT_name, "value");
+	b.data2(DW_AT_fund_type, DW_FT_signed_integer);
+	b.block2(DW_AT_location, location(0));
+	b.leaf();
+	b.close();
+
+	return type;
+}
+
+static std::map<std::string, std::string> readTree(const filesystem::path &root)
+{
+	std::map<std::string, std::string> files;
+
+	for (auto it = filesystem::recursive_directory_iterator(root); it != filesystem::recursive_directory_iterator(); ++it)
+	{
+		if (!filesystem::is_regular_file(it->path()))
+			continue;
+
+		std::ifstream in(it->path().string(), std::ios::binary);
+		std::stringstream text;
+		text << in.rdbuf();
+
+		files[it->path().string().substr(root.string().size())] = text.str();
+	}
+
+	return files;
+}
+
+// Converts image with one thread and with runPipeline, and compares the output.
+// expectFile has to contain expectText.
+static bool runCase(const char *name, const std::vector<char> &image, const std::string &expectFile, const std::string &expectText)
+{
+	filesystem::path dir = filesystem::temp_directory_path() / "dwarf2cpp_test";
+	filesystem::path elf = dir / "input.elf";
+	filesystem::path serial = dir / "serial";
+	filesystem::path pipelined = dir / "pipelined";
+
+	filesystem::remove_all(dir);
+	filesystem::create_directories(dir);
+	std::ofstream(elf.string(), std::ios::binary).write(image.data(), image.size());
+
+	SymbolTable *symbols = nullptr;
+	bool ok = convertElfFile(elf.string().c_str(), &symbols) != nullptr;
+
+	if (ok)
+	{
+		std::vector<Cpp::File*> files = takeConvertedFiles();
+		writeCppFiles(files, serial.string().c_str(), 1);
+	}
+
+	ok = ok && runPipeline(elf.string().c_str(), pipelined.string().c_str(), PIPELINE_JOBS) == 0;
+
+	std::string reason;
+
+	if (!ok)
+		reason = "conversion failed";
+	else
+	{
+		std::map<std::string, std::string> expected = readTree(serial);
+		std::map<std::string, std::string> actual = readTree(pipelined);
+
+		auto it = expected.find(expectFile);
+
+		if (it == expected.end() || it->second.find(expectText) == std::string::npos)
+			reason = "'" + expectText + "' missing from " + expectFile + " with one thread";
+
+		for (auto &x : expected)
+		{
+			if (reason.empty() && (actual.count(x.first) == 0 || actual[x.first] != x.second))
+				reason = x.first + " differs from the output with one thread";
+		}
+
+		if (reason.empty() && actual.size() != expected.size())
+			reason = "different files than with one thread";
+	}
+
+	filesystem::remove_all(dir);
+
+	if (!reason.empty())
+	{
+		std::cerr << "FAIL " << name << ": " << reason << std::endl;
+		return false;
+	}
+
+	std::cerr << "PASS " << name << std::endl;
+	return true;
+}
+
+// The mangled name of a function in a later compile unit attaches it to a
+// class converted long before
+static bool testLateMangledMethod()
+{
+	FixtureBuilder b;
+
+	addStructUnit(b, "src/foo.cpp", "Foo");
+	b.close();
+
+	for (int i = 0; i < FILLER_UNITS; i++)
+		addFillerUnit(b, i);
+
+	b.begin(DW_TAG_compile_unit);
+	b.string(DW_AT_name, "src/late.cpp");
+	b.children();
+	b.begin(DW_TAG_global_subroutine);
+	b.string(DW_AT_name, "LateMethod");
+	b.string(DW_AT_mangled_name, "LateMethod__3FooFv");
+	b.data2(DW_AT_fund_type, DW_FT_void);
+	b.leaf();
+	b.close();
+
+	return runCase("method attached by mangled name from a later compile unit", b.build(), "/src/foo.cpp", "LateMethod");
+}
+
+// A this parameter pointing into an earlier compile unit attaches the
+// function to the class there
+static bool testLateThisMethod()
+{
+	FixtureBuilder b;
+
+	Elf32_Off bar = addStructUnit(b, "src/bar.cpp", "Bar");
+	b.close();
+
+	for (int i = 0; i < FILLER_UNITS; i++)
+		addFillerUnit(b, i);
+
+	b.begin(DW_TAG_compile_unit);
+	b.string(DW_AT_name, "src/late.cpp");
+	b.children();
+	b.begin(DW_TAG_global_subroutine);
+	b.string(DW_AT_name, "Poke");
+	b.data2(DW_AT_fund_type, DW_FT_void);
+	b.children();
+	b.begin(DW_TAG_formal_parameter);
+	b.string(DW_AT_name, "this");
+	b.block2(DW_AT_mod_u_d_type, modifiedType({ DW_MOD_pointer_to }, bar));
+	b.leaf();
+	b.close();
+	b.close();
+
+	return runCase("method attached through this from a later compile unit", b.build(), "/src/bar.cpp", "Poke");
+}
+
+int main()
+{
+	int failed = 0;
+
+	failed += !testLateMangledMethod();
+	failed += !testLateThisMethod();
+
+	std::cerr << (failed ? "Some tests failed." : "All tests passed.") << std::endl;
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,75 @@
+#include "trace.h"
+
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+namespace Trace
+{
+	std::atomic<bool> enabled(false);
+
+	static std::mutex eventMutex;
+	static std::vector<std::string> events;
+	static std::string outFilename;
+	static std::atomic<int> nextThreadId(1);
+	static uint64_t startTime;
+
+	bool start(const char *filename)
+	{
+		FILE *file = fopen(filename, "w");
+
+		if (!file)
+			return false;
+
+		fclose(file);
+
+		outFilename = filename;
+		startTime = now();
+		enabled = true;
+
+		return true;
+	}
+
+	void stop()
+	{
+		if (!enabled.exchange(false))
+			return;
+
+		std::lock_guard<std::mutex> lock(eventMutex);
+		FILE *file = fopen(outFilename.c_str(), "w");
+
+		if (!file)
+			return;
+
+		fputs("{\"traceEvents\":[\n", file);
+
+		for (size_t i = 0; i < events.size(); i++)
+		{
+			fputs(events[i].c_str(), file);
+			fputs(i + 1 < events.size() ? ",\n" : "\n", file);
+		}
+
+		fputs("],\"displayTimeUnit\":\"ms\"}\n", file);
+		fclose(file);
+
+		std::vector<std::string>().swap(events);
+	}
+
+	void addEvent(const char *name, uint64_t start, uint64_t duration, const std::string &args)
+	{
+		thread_local int threadId = nextThreadId++;
+
+		std::string event = "{\"name\":\"" + std::string(name) +
+			"\",\"ph\":\"X\",\"pid\":1,\"tid\":" + std::to_string(threadId) +
+			",\"ts\":" + std::to_string(start - startTime) +
+			",\"dur\":" + std::to_string(duration);
+
+		if (!args.empty())
+			event += ",\"args\":{" + args + "}";
+
+		event += "}";
+
+		std::lock_guard<std::mutex> lock(eventMutex);
+		events.push_back(std::move(event));
+	}
+}
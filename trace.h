@@ -0,0 +1,105 @@
+/**************************************************************/
+/* Optional Chrome/Perfetto trace-event output. When tracing */
+/* is off, a span costs one relaxed atomic load.              */
+/**************************************************************/
+
+#pragma once
+
+#include "json.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace Trace
+{
+	extern std::atomic<bool> enabled;
+
+	// Starts collecting events, which are written to filename by stop()
+	bool start(const char *filename);
+	void stop();
+
+	// Records a complete ("X") event. args is a JSON object body, or empty.
+	void addEvent(const char *name, uint64_t start, uint64_t duration, const std::string &args);
+
+	inline bool isEnabled()
+	{
+		return enabled.load(std::memory_order_relaxed);
+	}
+
+	// Microseconds on a monotonic clock
+	inline uint64_t now()
+	{
+		return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+}
+
+// A span of time on the current thread, recorded when it ends or goes out of scope
+class TraceSpan
+{
+public:
+	TraceSpan() : m_name(nullptr), m_start(0), m_active(false)
+	{
+	}
+
+	explicit TraceSpan(const char *name) : TraceSpan()
+	{
+		begin(name);
+	}
+
+	~TraceSpan()
+	{
+		end();
+	}
+
+	TraceSpan(const TraceSpan&) = delete;
+	TraceSpan& operator=(const TraceSpan&) = delete;
+
+	inline void begin(const char *name)
+	{
+		if (!Trace::isEnabled())
+			return;
+
+		m_name = name;
+		m_start = Trace::now();
+		m_active = true;
+		m_args.clear();
+	}
+
+	inline void arg(const char *key, int64_t value)
+	{
+		if (m_active)
+			appendArg(key, std::to_string(value));
+	}
+
+	inline void arg(const char *key, const std::string &value)
+	{
+		if (m_active)
+			appendArg(key, Json::escape(value));
+	}
+
+	inline void end()
+	{
+		if (!m_active)
+			return;
+
+		Trace::addEvent(m_name, m_start, Trace::now() - m_start, m_args);
+		m_active = false;
+	}
+
+private:
+	const char *m_name;
+	uint64_t m_start;
+	bool m_active;
+	std::string m_args;
+
+	void appendArg(const char *key, const std::string &json)
+	{
+		if (!m_args.empty())
+			m_args += ",";
+
+		m_args.append("\"").append(key).append("\":").append(json);
+	}
+};
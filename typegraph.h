@@ -0,0 +1,162 @@
+/******************************************************************/
+/* Dependencies between user types, for output that has to define */
+/* each type after the types it needs complete.                   */
+/******************************************************************/
+
+#pragma once
+
+#include "cpp.h"
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Node is the type deriving from this, so graphs can keep their own data on it
+template<typename Node>
+struct TypeGraphNode
+{
+	Cpp::UserType *type;
+	std::vector<Node*> needs;        // Types that have to be complete first
+	std::vector<Node*> declarations; // Classes only used through pointers or references
+	int visit = 0;
+};
+
+// A type needs its base classes, the members and array elements it holds by
+// value, and the enums and typedefs it uses complete. Classes it only refers
+// to through pointers or references can be forward declared instead.
+template<typename Node>
+class TypeGraph
+{
+public:
+	virtual ~TypeGraph()
+	{
+	}
+
+	static inline bool isClassType(Cpp::UserType *ut)
+	{
+		return ut->type == Cpp::UserType::CLASS || ut->type == Cpp::UserType::STRUCT || ut->type == Cpp::UserType::UNION;
+	}
+
+protected:
+	enum
+	{
+		VISIT_NONE,
+		VISIT_ACTIVE,
+		VISIT_DONE
+	};
+
+	std::vector<std::unique_ptr<Node>> m_nodes;
+	std::unordered_map<Cpp::UserType*, Node*> m_byType;
+	std::unordered_map<std::string, Node*> m_byName;
+
+	// Names that types are written under instead of their own, like generated
+	// names made unique. The types only have them while they're written.
+	std::unordered_map<Cpp::UserType*, std::string> m_names;
+
+	// Gives the types in m_names their new names, or back their own ones
+	void swapNames()
+	{
+		for (auto &x : m_names)
+			std::swap(x.first->name, x.second);
+	}
+
+	// The node of a type that's referred to, or null to leave the type out
+	virtual Node* getNode(Cpp::UserType *ut) = 0;
+
+	void addDependencies(Node *node)
+	{
+		Cpp::UserType *ut = node->type;
+
+		switch (ut->type)
+		{
+		case Cpp::UserType::CLASS:
+		case Cpp::UserType::STRUCT:
+		case Cpp::UserType::UNION:
+			for (Cpp::ClassType::Inheritance &i : ut->classData->inheritances)
+				addDependency(node, i.type, true);
+
+			for (Cpp::ClassType::Member &m : ut->classData->members)
+				addDependency(node, m.type, !m.type.isPointer());
+
+			for (Cpp::Function &fun : ut->classData->functions)
+			{
+				addDependency(node, fun.returnType, false);
+
+				for (Cpp::FunctionType::Parameter &p : fun.parameters)
+					addDependency(node, p.type, false);
+			}
+
+			break;
+		case Cpp::UserType::ARRAY:
+			addDependency(node, ut->arrayData->type, !ut->arrayData->type.isPointer());
+			break;
+		case Cpp::UserType::FUNCTION:
+			addDependency(node, ut->functionData->returnType, false);
+
+			for (Cpp::FunctionType::Parameter &p : ut->functionData->parameters)
+				addDependency(node, p.type, false);
+
+			break;
+		case Cpp::UserType::ENUM:
+			// Enums don't refer to other types
+			break;
+		}
+	}
+
+	// node may be null to only reach the type
+	void addDependency(Node *node, Cpp::Type &type, bool complete)
+	{
+		if (type.isFundamentalType || !type.userType)
+			return;
+
+		Node *target = getNode(type.userType);
+
+		if (!node || !target || target == node)
+			return;
+
+		// Enums and typedefs can't be forward declared, so they're always needed
+		if (complete || !isClassType(target->type))
+			addUnique(node->needs, target);
+		else
+			addUnique(node->declarations, target);
+	}
+
+	// Appends node to order after everything it needs
+	void sort(Node *node, std::vector<Node*> &order)
+	{
+		if (node->visit == VISIT_DONE)
+			return;
+
+		node->visit = VISIT_ACTIVE;
+
+		for (auto it = node->needs.begin(); it != node->needs.end();)
+		{
+			Node *need = *it;
+
+			if (need->visit == VISIT_ACTIVE)
+			{
+				// Needing each other complete can't work, so fall back to a forward declaration
+				std::cout << "Warning: " << node->type->name << " and " << need->type->name << " depend on each other." << std::endl;
+
+				addUnique(node->declarations, need);
+				it = node->needs.erase(it);
+				continue;
+			}
+
+			sort(need, order);
+			++it;
+		}
+
+		node->visit = VISIT_DONE;
+		order.push_back(node);
+	}
+
+	static inline void addUnique(std::vector<Node*> &nodes, Node *node)
+	{
+		if (std::find(nodes.begin(), nodes.end(), node) == nodes.end())
+			nodes.push_back(node);
+	}
+};
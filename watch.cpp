@@ -0,0 +1,614 @@
+#include "watch.h"
+#include "convert.h"
+#include "export.h"
+#include "hash.h"
+#include "search.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <set>
+#include <thread>
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#include <experimental/filesystem>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace filesystem = std::experimental::filesystem;
+
+// A rebuild is handled once the file has been left alone for this long
+#define WATCH_SETTLE_MS 200
+
+// How often the file is checked where inotify isn't available
+#define WATCH_POLL_MS 500
+
+static int64_t getLastWriteTime(const std::string &filename)
+{
+	std::error_code ec;
+	auto time = filesystem::last_write_time(filename, ec);
+
+	if (ec)
+		return 0;
+
+	return (int64_t)time.time_since_epoch().count();
+}
+
+WatchSession::WatchSession(const char *elfFilename, const char *output, int jobs, const OutputOptions &options) :
+	m_elfFilename(elfFilename), m_output(output), m_jobs(jobs), m_options(options), m_notify(-1), m_lastWriteTime(0)
+{
+#ifdef __linux__
+	filesystem::path path(m_elfFilename);
+	std::string directory = path.has_parent_path() ? path.parent_path().string() : ".";
+
+	// Watching the directory also catches the file being replaced rather than rewritten
+	m_notify = inotify_init1(IN_CLOEXEC);
+
+	if (m_notify >= 0 && inotify_add_watch(m_notify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+	{
+		close(m_notify);
+		m_notify = -1;
+	}
+#endif
+}
+
+int WatchSession::run()
+{
+	if (!update(true))
+		return 1;
+
+	while (true)
+	{
+		std::cout << "Watching " << m_elfFilename << " for changes..." << std::endl;
+
+		if (!waitForChange())
+			return 1;
+
+		update(false);
+	}
+}
+
+bool WatchSession::waitForChange()
+{
+#ifdef __linux__
+	if (m_notify >= 0)
+	{
+		std::string name = filesystem::path(m_elfFilename).filename().string();
+		bool changed = false;
+		char buffer[4096];
+
+		while (true)
+		{
+			pollfd fd = { m_notify, POLLIN, 0 };
+
+			// Once the file has changed, wait for the writes to settle
+			int ready = poll(&fd, 1, changed ? WATCH_SETTLE_MS : -1);
+
+			if (ready < 0)
+				return false;
+
+			if (ready == 0)
+				return true;
+
+			ssize_t size = read(m_notify, buffer, sizeof(buffer));
+
+			for (ssize_t i = 0; i < size; )
+			{
+				inotify_event *event = (inotify_event*)(buffer + i);
+
+				if (event->len > 0 && name == event->name)
+					changed = true;
+
+				i += sizeof(inotify_event) + event->len;
+			}
+		}
+	}
+#endif
+
+	while (true)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(WATCH_POLL_MS));
+
+		int64_t time = getLastWriteTime(m_elfFilename);
+
+		if (time == m_lastWriteTime)
+			continue;
+
+		// Wait for the writes to settle
+		do
+		{
+			m_lastWriteTime = time;
+			std::this_thread::sleep_for(std::chrono::milliseconds(WATCH_SETTLE_MS));
+			time = getLastWriteTime(m_elfFilename);
+		} while (time != m_lastWriteTime);
+
+		return true;
+	}
+}
+
+bool WatchSession::update(bool first)
+{
+	auto startTime = std::chrono::steady_clock::now();
+
+	m_lastWriteTime = getLastWriteTime(m_elfFilename);
+
+	std::cout << "Loading ELF file " << m_elfFilename << "..." << std::endl;
+
+	ElfFile *elf = new ElfFile(m_elfFilename.c_str());
+
+	if (elf->getError() || !elf->getSectionHeader(".debug"))
+	{
+		std::cout << "Failed to read DWARF data from " << m_elfFilename << "." << std::endl;
+		delete elf;
+		return false;
+	}
+
+	// Skips every compile unit, so only the section and line data are read
+	Dwarf scan(elf, usedAttributes, [](const char*, size_t) { return false; });
+
+	if (scan.getError())
+	{
+		std::cout << "Failed to parse DWARF data. Error Code: " << scan.getError() << std::endl;
+		delete elf;
+		return false;
+	}
+
+	std::vector<Unit*> units;
+	std::unordered_map<std::string, Unit*> byName;
+	std::vector<Range> ranges;
+
+	findUnits(&scan, units, byName);
+
+	for (Unit *unit : units)
+	{
+		for (uint32_t i = 0; i < unit->ranges.size(); i++)
+			ranges.push_back({ unit->ranges[i].first, unit->ranges[i].second, unit, i });
+	}
+
+	std::sort(ranges.begin(), ranges.end(), [](const Range &a, const Range &b) { return a.start < b.start; });
+
+	for (Unit *unit : units)
+		hashUnit(&scan, unit, ranges);
+
+	// Units that changed or went away, then the units that refer to those
+	std::set<std::string> changed;
+	std::set<std::string> stale;
+
+	for (Unit *unit : units)
+	{
+		auto old = m_unitsByName.find(unit->name);
+
+		if (old == m_unitsByName.end() || old->second->hash != unit->hash)
+			changed.insert(unit->name);
+	}
+
+	for (Unit *old : m_units)
+	{
+		if (byName.count(old->name) == 0)
+			stale.insert(old->name);
+	}
+
+	stale.insert(changed.begin(), changed.end());
+
+	for (bool grew = true; grew; )
+	{
+		grew = false;
+
+		for (Unit *unit : units)
+		{
+			if (changed.count(unit->name))
+				continue;
+
+			for (const std::string &dependency : unit->dependencies)
+			{
+				if (stale.count(dependency))
+				{
+					changed.insert(unit->name);
+					stale.insert(unit->name);
+					grew = true;
+					break;
+				}
+			}
+		}
+	}
+
+	// Unchanged units keep what they were converted to
+	for (Unit *unit : units)
+	{
+		if (changed.count(unit->name))
+			continue;
+
+		Unit *old = m_unitsByName[unit->name];
+		unit->file = old->file;
+		unit->generation = old->generation;
+		unit->types.swap(old->types);
+		old->generation = nullptr;
+	}
+
+	if (changed.empty())
+		delete elf;
+	else
+	{
+		Generation *generation = new Generation{ elf, nullptr, 0 };
+
+		skippedTypeResolver = [&](Elf32_Off ref) -> Cpp::UserType*
+		{
+			uint64_t key;
+			Unit *unit = findUnit(ranges, ref, &key);
+
+			if (!unit || changed.count(unit->name))
+				return nullptr;
+
+			auto it = unit->types.find(key);
+			return (it != unit->types.end()) ? it->second : nullptr;
+		};
+
+		Dwarf *dwarf = new Dwarf(elf, usedAttributes,
+			[&](const char *name, size_t length) { return changed.count(std::string(name, length)) > 0; });
+
+		generation->dwarf = dwarf;
+
+		if (dwarf->getError() || !processDwarf(dwarf))
+			std::cout << "Failed to convert the changed compile units." << std::endl;
+
+		for (auto &pair : entryUTPairs)
+		{
+			uint64_t key;
+			Unit *unit;
+
+			// Types read on demand belong to the unit that needed them
+			if (pair.first->index >= 0 && (unit = findUnit(ranges, pair.first->offset, &key)) && changed.count(unit->name))
+				unit->types[key] = pair.second;
+		}
+
+		skippedTypeResolver = nullptr;
+
+		std::vector<Cpp::File*> files = takeConvertedFiles();
+		applySymbolTable(files, SymbolTable(elf), !elf->isRelocatable());
+		dwarf->freeEntries();
+
+		for (Cpp::File *cpp : files)
+		{
+			auto it = byName.find(cpp->filename);
+
+			if (it == byName.end() || it->second->file)
+			{
+				deleteFile(cpp);
+				continue;
+			}
+
+			it->second->file = cpp;
+			it->second->generation = generation;
+			generation->users++;
+		}
+
+		// Compile units that failed to convert are written empty
+		for (Unit *unit : units)
+		{
+			if (!unit->file)
+			{
+				unit->file = new Cpp::File;
+				unit->file->filename = unit->name;
+			}
+		}
+
+		if (generation->users == 0)
+			release(generation);
+	}
+
+	for (Unit *old : m_units)
+	{
+		if (stale.count(old->name))
+		{
+			deleteFile(old->file);
+			release(old->generation);
+		}
+
+		delete old;
+	}
+
+	m_units = units;
+	m_unitsByName = byName;
+
+	std::vector<Cpp::File*> allFiles;
+	std::vector<Cpp::File*> changedFiles;
+
+	for (Unit *unit : units)
+	{
+		allFiles.push_back(unit->file);
+
+		if (changed.count(unit->name))
+			changedFiles.push_back(unit->file);
+	}
+
+	// Every file only needs to be written again when they're combined
+	if (!first && m_options.mode == OutputOptions::DIRECTORY)
+	{
+		OutputOptions options = m_options;
+		options.exportFilename = nullptr;
+		options.indexFilename = nullptr;
+
+		if (!changedFiles.empty())
+			writeCppFiles(changedFiles, m_output.c_str(), m_jobs, options);
+
+		if (m_options.exportFilename)
+			writeExport(allFiles, m_options.exportFilename);
+
+		if (m_options.indexFilename)
+			writeNameIndex(allFiles, m_options.indexFilename);
+	}
+	else if (first || !changedFiles.empty())
+		writeCppFiles(allFiles, m_output.c_str(), m_jobs, m_options);
+
+	auto time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime);
+
+	std::cout << "Converted " << changedFiles.size() << " of " << units.size() << " compile units in " << time.count() << " ms." << std::endl;
+
+	for (const std::string &name : stale)
+	{
+		if (byName.count(name) == 0)
+			std::cout << "\tRemoved " << name << std::endl;
+	}
+
+	std::cout << std::endl;
+
+	return true;
+}
+
+void WatchSession::findUnits(Dwarf *dwarf, std::vector<Unit*> &units, std::unordered_map<std::string, Unit*> &byName)
+{
+	Elf32_Off offset = 0;
+	Elf32_Word size = dwarf->getSectionSize();
+	Unit *open = nullptr; // A compile unit without a sibling, which runs until the next one
+
+	while (size - offset >= sizeof(Elf32_Word))
+	{
+		Dwarf::Entry entry;
+
+		if (!dwarf->peekEntry(offset, &entry) || entry.length < sizeof(Elf32_Word) || entry.length > size - offset)
+			break;
+
+		Dwarf::Attribute *name = entry.get(DW_AT_name);
+		Dwarf::Attribute *sibling = entry.get(DW_AT_sibling);
+		Elf32_Off end = offset + entry.length;
+		bool hasSibling = sibling && sibling->getReference() > end && sibling->getReference() <= size;
+
+		if (hasSibling)
+			end = sibling->getReference();
+
+		if (entry.tag != DW_TAG_compile_unit)
+		{
+			if (open)
+				open->ranges.back().second = end;
+
+			offset = end;
+			continue;
+		}
+
+		open = nullptr;
+
+		if (name && (!extractFilter.compileUnits.isActive() || extractFilter.compileUnits.matches(name->getString(), name->getStringLength())))
+		{
+			std::string filename(name->getString(), name->getStringLength());
+			Unit *&unit = byName[filename];
+
+			if (!unit)
+			{
+				unit = new Unit();
+				unit->name = filename;
+				unit->hash = 0;
+				unit->file = nullptr;
+				unit->generation = nullptr;
+				units.push_back(unit);
+			}
+
+			unit->ranges.push_back(std::make_pair(offset, end));
+
+			if (!hasSibling)
+				open = unit;
+		}
+
+		offset = end;
+	}
+}
+
+void WatchSession::hashUnit(Dwarf *dwarf, Unit *unit, const std::vector<Range> &ranges)
+{
+	uint64_t h = hashMix(FNV_OFFSET, unit->ranges.size());
+
+	for (const std::pair<Elf32_Off, Elf32_Off> &range : unit->ranges)
+	{
+		Elf32_Off offset = range.first;
+
+		while (offset < range.second)
+		{
+			Dwarf::Entry entry;
+			entry.dwarf = dwarf;
+			entry.index = -1;
+			entry.offset = offset;
+			entry.length = dwarf->read<Elf32_Word>(dwarf->offsetToPointer(offset));
+
+			if (entry.length < sizeof(Elf32_Word) || entry.length > range.second - offset)
+			{
+				h = hashMix(h, offset - range.first);
+				break;
+			}
+
+			h = hashMix(h, entry.length);
+
+			Elf32_Off end = offset + entry.length;
+
+			if (!entry.isNullEntry())
+			{
+				Elf32_Off a = offset + sizeof(Elf32_Word);
+
+				h = hashMix(h, dwarf->read<Elf32_Half>(dwarf->offsetToPointer(a)));
+				a += sizeof(Elf32_Half);
+
+				while (end - a >= sizeof(Elf32_Half))
+				{
+					Dwarf::Attribute attr;
+					Elf32_Off next = dwarf->decodeAttribute(a, &entry, &attr);
+
+					if (dwarf->getError() || next <= a || next > end)
+						break;
+
+					h = hashAttribute(dwarf, &entry, &attr, unit, ranges, h);
+					a = next;
+				}
+			}
+
+			offset = end;
+		}
+	}
+
+	unit->hash = h;
+}
+
+uint64_t WatchSession::hashAttribute(Dwarf *dwarf, Dwarf::Entry *entry, Dwarf::Attribute *attr, Unit *unit, const std::vector<Range> &ranges, uint64_t h)
+{
+	// References are hashed by the unit they point into and their place in it
+	auto hashReference = [&](Elf32_Off ref)
+	{
+		// Siblings of the last entries point just past the unit
+		for (uint32_t i = 0; i < unit->ranges.size(); i++)
+		{
+			if (ref >= unit->ranges[i].first && ref <= unit->ranges[i].second)
+				return hashMix(hashMix(h, 1), ((uint64_t)i << 32) | (ref - unit->ranges[i].first));
+		}
+
+		uint64_t key;
+		Unit *target = findUnit(ranges, ref, &key);
+
+		if (!target)
+			return hashMix(hashMix(h, 2), ref);
+
+		if (std::find(unit->dependencies.begin(), unit->dependencies.end(), target->name) == unit->dependencies.end())
+			unit->dependencies.push_back(target->name);
+
+		return hashMix(hashBytes(hashMix(h, 3), target->name.data(), target->name.size()), key);
+	};
+
+	char *value = attr->getBlock();
+
+	h = hashMix(h, attr->name);
+
+	if (attr->getForm() == DW_FORM_REF)
+		return hashReference(attr->getReference());
+
+	if (attr->name == DW_AT_mod_u_d_type && attr->size >= sizeof(Elf32_Off))
+	{
+		h = hashBytes(h, value, attr->size - sizeof(Elf32_Off));
+		return hashReference(dwarf->read<Elf32_Off>(value + attr->size - sizeof(Elf32_Off)));
+	}
+
+	if (attr->name == DW_AT_subscr_data)
+	{
+		char *block = value;
+		char *end = value + attr->size;
+
+		// Dimensions with constant bounds, then the element type
+		while ((size_t)(end - block) >= 1 + sizeof(Elf32_Half) + 2 * sizeof(Elf32_Word) && *block == DW_FMT_FT_C_C)
+		{
+			h = hashBytes(h, block, 1 + sizeof(Elf32_Half) + 2 * sizeof(Elf32_Word));
+			block += 1 + sizeof(Elf32_Half) + 2 * sizeof(Elf32_Word);
+		}
+
+		if (end - block > 1 + (ptrdiff_t)sizeof(Elf32_Half) && *block == DW_FMT_ET)
+		{
+			Dwarf::Attribute type;
+			Elf32_Off offset = dwarf->pointerToOffset(block + 1);
+			Elf32_Off next = dwarf->decodeAttribute(offset, entry, &type);
+
+			if (!dwarf->getError() && next <= dwarf->pointerToOffset(end))
+			{
+				h = hashAttribute(dwarf, entry, &type, unit, ranges, h);
+				block = dwarf->offsetToPointer(next);
+			}
+		}
+
+		return hashBytes(h, block, end - block);
+	}
+
+	h = hashBytes(h, value, attr->size);
+
+	// Line numbers are in .line, by function address
+	if (attr->name == DW_AT_low_pc)
+	{
+		auto lines = dwarf->lineEntryMap.equal_range((int)attr->getAddress());
+
+		for (auto it = lines.first; it != lines.second; ++it)
+		{
+			h = hashMix(h, it->second.lineNumber);
+			h = hashMix(h, it->second.charOffset);
+			h = hashMix(h, it->second.hexAddressOffset);
+		}
+	}
+
+	return h;
+}
+
+WatchSession::Unit* WatchSession::findUnit(const std::vector<Range> &ranges, Elf32_Off offset, uint64_t *outKey)
+{
+	auto it = std::upper_bound(ranges.begin(), ranges.end(), offset,
+		[](Elf32_Off o, const Range &range) { return o < range.start; });
+
+	if (it == ranges.begin() || offset >= (it - 1)->end)
+		return nullptr;
+
+	const Range &range = *(it - 1);
+	*outKey = ((uint64_t)range.index << 32) | (offset - range.start);
+
+	return range.unit;
+}
+
+void WatchSession::release(Generation *generation)
+{
+	if (!generation || --generation->users > 0)
+		return;
+
+	delete generation->dwarf;
+	delete generation->elf;
+	delete generation;
+}
+
+void WatchSession::deleteFile(Cpp::File *cpp)
+{
+	if (!cpp)
+		return;
+
+	for (Cpp::UserType *ut : cpp->userTypes)
+	{
+		switch (ut->type)
+		{
+		case Cpp::UserType::CLASS:
+		case Cpp::UserType::STRUCT:
+		case Cpp::UserType::UNION:
+			delete ut->classData;
+			break;
+		case Cpp::UserType::ENUM:
+			delete ut->enumData;
+			break;
+		case Cpp::UserType::ARRAY:
+			delete ut->arrayData;
+			break;
+		case Cpp::UserType::FUNCTION:
+			delete ut->functionData;
+			break;
+		}
+
+		delete ut->layout;
+		delete ut;
+	}
+
+	delete cpp;
+}
+
+int runWatch(const char *elfFilename, const char *output, int jobs, const OutputOptions &options)
+{
+	WatchSession session(elfFilename, output, jobs, options);
+	return session.run();
+}
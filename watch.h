@@ -0,0 +1,84 @@
+#pragma once
+
+#include "output.h"
+#include "dwarf.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// Converts an ELF file, then waits for it to be rebuilt and converts it again,
+// keeping the compile units that didn't change.
+//
+// Each compile unit is hashed from its entries in .debug and its functions'
+// line numbers. References are hashed relative to the compile unit they point
+// into, so a compile unit moving in the section doesn't change its hash. Only
+// compile units whose hash changed, and those that refer to their types, are
+// converted and written again. References to the others are resolved to the
+// types kept from earlier rebuilds.
+class WatchSession
+{
+public:
+	WatchSession(const char *elfFilename, const char *output, int jobs, const OutputOptions &options);
+
+	// Never returns unless the first conversion fails
+	int run();
+
+private:
+	// The ELF file and DWARF data a compile unit was converted from. Functions
+	// keep using its line numbers after later rebuilds.
+	struct Generation
+	{
+		ElfFile *elf;
+		Dwarf *dwarf;
+		int users;
+	};
+
+	// The compile units with the same name, which are converted into one file
+	struct Unit
+	{
+		std::string name;
+		std::vector<std::pair<Elf32_Off, Elf32_Off>> ranges;
+		uint64_t hash;
+		std::vector<std::string> dependencies; // Units this one refers to
+		Cpp::File *file;
+		Generation *generation;
+
+		// Converted types by range index (high 32 bits) and offset in the range
+		std::unordered_map<uint64_t, Cpp::UserType*> types;
+	};
+
+	std::string m_elfFilename;
+	std::string m_output;
+	int m_jobs;
+	OutputOptions m_options;
+
+	// A compile unit's range in .debug, for finding the unit an offset is in
+	struct Range
+	{
+		Elf32_Off start;
+		Elf32_Off end;
+		Unit *unit;
+		uint32_t index;
+	};
+
+	std::vector<Unit*> m_units;
+	std::unordered_map<std::string, Unit*> m_unitsByName;
+
+	int m_notify; // inotify descriptor, on Linux
+	int64_t m_lastWriteTime; // Elsewhere, the file's last write time, which is polled
+
+	bool update(bool first);
+	bool waitForChange();
+
+	void findUnits(Dwarf *dwarf, std::vector<Unit*> &units, std::unordered_map<std::string, Unit*> &byName);
+	void hashUnit(Dwarf *dwarf, Unit *unit, const std::vector<Range> &ranges);
+	uint64_t hashAttribute(Dwarf *dwarf, Dwarf::Entry *entry, Dwarf::Attribute *attr, Unit *unit, const std::vector<Range> &ranges, uint64_t h);
+	Unit* findUnit(const std::vector<Range> &ranges, Elf32_Off offset, uint64_t *outKey);
+
+	void release(Generation *generation);
+	void deleteFile(Cpp::File *cpp);
+};
+
+int runWatch(const char *elfFilename, const char *output, int jobs, const OutputOptions &options = OutputOptions());